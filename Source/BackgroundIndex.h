@@ -0,0 +1,72 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "IndexHandoff.h"
+
+// The thread side of an analysis index of the loaded sample: starting a
+// build, cancelling it, and picking finished indexes up at the start of a
+// block. Subclasses build their index from the source in buildIndex(),
+// publish it to their own IndexHandoff and pick it up in pickUpIndex().
+// They call cancel() in their destructor, while buildIndex() can still run.
+class BackgroundIndex : private juce::Thread
+{
+public:
+    // Message thread. The source must stay unchanged until cancel() or the next build().
+    void build(const juce::AudioBuffer<float>& source, double sampleRate, uint32_t sourceVersion)
+    {
+        cancel();
+
+        pendingSource = &source;
+        pendingSampleRate = sampleRate;
+        pendingVersion = requestedVersion = sourceVersion;
+        startThread();
+    }
+
+    void cancel()
+    {
+        stopThread(2000);
+        pendingSource = nullptr;
+        requestedVersion = 0;
+    }
+
+    bool isBuildingOrBuilt(uint32_t sourceVersion) const { return requestedVersion == sourceVersion; }
+
+    // Any thread but the builder. Waits up to timeoutMs for a build in
+    // progress; true when none is left running.
+    bool waitUntilBuilt(int timeoutMs) const { return waitForThreadToExit(timeoutMs); }
+
+    // Audio thread, at the start of a block. Offline renders wait for a build
+    // in progress, for MAX_RENDER_WAIT_MS at most so the render thread never
+    // hangs on one; tools that must have the index call waitUntilBuilt() first.
+    void update(bool waitForBuild)
+    {
+        if (waitForBuild && isThreadRunning())
+            waitForThreadToExit(MAX_RENDER_WAIT_MS);
+
+        pickUpIndex();
+    }
+
+    static constexpr int MAX_RENDER_WAIT_MS = 1000;
+
+protected:
+    explicit BackgroundIndex(const juce::String& threadName) : juce::Thread(threadName) {}
+
+    // Builder thread. Returns without publishing once threadShouldExit() is set.
+    virtual void buildIndex(const juce::AudioBuffer<float>& source, double sampleRate, uint32_t sourceVersion) = 0;
+
+    // Audio thread, from update()
+    virtual void pickUpIndex() = 0;
+
+    using juce::Thread::threadShouldExit;
+
+private:
+    void run() override
+    {
+        buildIndex(*pendingSource, pendingSampleRate, pendingVersion);
+    }
+
+    const juce::AudioBuffer<float>* pendingSource = nullptr;
+    double pendingSampleRate = 44100.0;
+    uint32_t pendingVersion = 0;
+    uint32_t requestedVersion = 0;
+};
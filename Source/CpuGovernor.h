@@ -0,0 +1,91 @@
+#pragma once
+
+#include "SamplePlayer.h"
+#include <algorithm>
+
+// Trades render quality for CPU when processBlock gets close to its deadline.
+// Each level gives up one more thing: interpolation taps, then grains per
+// voice and cloud grains, then polyphony. It steps down quickly when the load
+// is high and steps back up only after a stretch of comfortable blocks, so the
+// quality doesn't flap around the threshold. Oversampling is left alone:
+// switching it clears the clipper's filters and changes the latency.
+class CpuGovernor
+{
+public:
+    static constexpr int NUM_LEVELS = 4;  // 0 is full quality
+
+    static SamplePlayer::RenderQuality getQualityForLevel(int level)
+    {
+        SamplePlayer::RenderQuality quality;
+        if (level >= 1) quality.interpolationPoints = 4;
+        if (level >= 2) { quality.interpolationPoints = 2; quality.maxGrainsPerVoice = 2; quality.maxCloudGrains = 128; }
+        if (level >= 3) { quality.maxGrainsPerVoice = 1; quality.maxCloudGrains = 32; quality.maxVoices = SamplePlayer::MAX_VOICES / 2; }
+        return quality;
+    }
+
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        reset();
+    }
+
+    void reset()
+    {
+        level = 0;
+        smoothedLoad = 0.0;
+        samplesSinceStepDown = samplesInHeadroom = 0;
+    }
+
+    // Audio thread, after each block. Returns true when the level changed.
+    bool update(double blockSeconds, int numSamples)
+    {
+        if (numSamples <= 0)
+            return false;
+
+        const double blockDuration = numSamples / sampleRate;
+        const double load = blockSeconds / blockDuration;
+
+        // Rises at once, falls over about LOAD_RELEASE_SECONDS
+        const double fall = std::min(1.0, blockDuration / LOAD_RELEASE_SECONDS);
+        smoothedLoad = load > smoothedLoad ? load : smoothedLoad + (load - smoothedLoad) * fall;
+
+        samplesSinceStepDown += numSamples;
+        samplesInHeadroom = smoothedLoad < STEP_UP_LOAD ? samplesInHeadroom + numSamples : 0;
+
+        // A step down needs a moment to show up in the measurements before the next one
+        if (smoothedLoad > STEP_DOWN_LOAD && level < NUM_LEVELS - 1
+            && samplesSinceStepDown >= static_cast<juce::int64>(SETTLE_SECONDS * sampleRate))
+        {
+            ++level;
+            samplesSinceStepDown = samplesInHeadroom = 0;
+            return true;
+        }
+
+        if (level > 0 && samplesInHeadroom >= static_cast<juce::int64>(RECOVERY_SECONDS * sampleRate))
+        {
+            --level;
+            samplesInHeadroom = 0;
+            return true;
+        }
+
+        return false;
+    }
+
+    int getLevel() const { return level; }
+    double getSmoothedLoad() const { return smoothedLoad; }
+
+private:
+    // Fractions of the block deadline
+    static constexpr double STEP_DOWN_LOAD = 0.75;
+    static constexpr double STEP_UP_LOAD = 0.4;
+
+    static constexpr double LOAD_RELEASE_SECONDS = 0.1;
+    static constexpr double SETTLE_SECONDS = 0.25;  // Longer than the load release
+    static constexpr double RECOVERY_SECONDS = 2.0;
+
+    double sampleRate = 44100.0;
+    int level = 0;
+    double smoothedLoad = 0.0;
+    juce::int64 samplesSinceStepDown = 0;
+    juce::int64 samplesInHeadroom = 0;
+};
@@ -0,0 +1,122 @@
+#include "DSPArena.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#if defined(__linux__)
+ #include <sys/mman.h>
+#endif
+
+namespace
+{
+    constexpr size_t roundUp(size_t value, size_t multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+}
+
+DSPArena::~DSPArena()
+{
+    release();
+}
+
+void DSPArena::AlignedDelete::operator()(std::byte* memory) const
+{
+    ::operator delete[](memory, std::align_val_t(ALIGNMENT));
+}
+
+void DSPArena::beginMeasure()
+{
+    release();
+    measuring = true;
+    capacity = 0;
+}
+
+void DSPArena::commit(bool tryHugePages)
+{
+    const size_t size = roundUp(std::max(capacity, ALIGNMENT), ALIGNMENT);
+    measureChunks.clear();
+    measuring = false;
+
+   #if defined(__linux__)
+    // Transparent huge pages: a 2 MB aligned mapping the kernel may back with
+    // huge pages, so the whole instance sits behind one or two TLB entries.
+    // mmap only promises page alignment, so a huge page more is mapped and
+    // the unaligned head and the tail beyond the block are unmapped again.
+    if (tryHugePages)
+    {
+        const size_t mappedSize = roundUp(size, HUGE_PAGE_SIZE);
+        const size_t paddedSize = mappedSize + HUGE_PAGE_SIZE;
+        void* memory = mmap(nullptr, paddedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory != MAP_FAILED)
+        {
+            auto* start = static_cast<std::byte*>(memory);
+            auto* aligned = reinterpret_cast<std::byte*>(roundUp(reinterpret_cast<uintptr_t>(start), HUGE_PAGE_SIZE));
+            const size_t head = static_cast<size_t>(aligned - start);
+
+            if (head > 0)
+                munmap(start, head);
+            munmap(aligned + mappedSize, paddedSize - head - mappedSize);
+
+            hugePages = madvise(aligned, mappedSize, MADV_HUGEPAGE) == 0;
+            block = aligned;
+            capacity = mappedSize;
+            mapped = true;
+        }
+    }
+   #else
+    (void) tryHugePages;
+   #endif
+
+    if (block == nullptr)
+    {
+        block = static_cast<std::byte*>(::operator new[](size, std::align_val_t(ALIGNMENT)));
+        capacity = size;
+    }
+
+    std::memset(block, 0, capacity);
+    used = 0;
+}
+
+void* DSPArena::allocateBytes(size_t numBytes)
+{
+    const size_t alignedBytes = roundUp(std::max(numBytes, size_t(1)), ALIGNMENT);
+
+    if (measuring)
+    {
+        capacity += alignedBytes;
+        measureChunks.emplace_back(static_cast<std::byte*>(::operator new[](alignedBytes, std::align_val_t(ALIGNMENT))));
+        std::memset(measureChunks.back().get(), 0, alignedBytes);
+        return measureChunks.back().get();
+    }
+
+    // Running past the measured size means the two layout passes disagreed
+    if (block == nullptr || used + alignedBytes > capacity)
+        throw std::bad_alloc();
+
+    void* memory = block + used;
+    used += alignedBytes;
+    return memory;
+}
+
+void DSPArena::release()
+{
+    measureChunks.clear();
+
+    if (block != nullptr)
+    {
+       #if defined(__linux__)
+        if (mapped)
+            munmap(block, capacity);
+        else
+       #endif
+            ::operator delete[](block, std::align_val_t(ALIGNMENT));
+    }
+
+    block = nullptr;
+    capacity = used = 0;
+    hugePages = mapped = false;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// One contiguous, cache-line aligned block for an instance's real-time state.
+// Sizing is done by running the same layout code twice: once after
+// beginMeasure(), which hands out temporary memory and records the total,
+// then again after commit(), which carves from a single block of that size.
+class DSPArena
+{
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    DSPArena() = default;
+    ~DSPArena();
+
+    // Message thread, inside prepareToPlay
+    void beginMeasure();
+    void commit(bool tryHugePages);
+
+    template <typename T>
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(allocateBytes(count * sizeof(T)));
+    }
+
+    size_t getSize() const { return capacity; }
+    bool isHugePageBacked() const { return hugePages; }
+
+private:
+    void* allocateBytes(size_t numBytes);
+    void release();
+
+    struct AlignedDelete { void operator()(std::byte* block) const; };
+
+    // Measure pass
+    bool measuring = false;
+    std::vector<std::unique_ptr<std::byte[], AlignedDelete>> measureChunks;
+
+    // Committed block
+    std::byte* block = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    bool hugePages = false;
+    bool mapped = false;
+
+    DSPArena(const DSPArena&) = delete;
+    DSPArena& operator=(const DSPArena&) = delete;
+};
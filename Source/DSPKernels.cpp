@@ -0,0 +1,313 @@
+#include "DSPKernels.h"
+#include "DSPUtils.h"
+
+// Each kernel body is written once, force-inlined into a wrapper per ISA.
+// The wrappers carry a target attribute, so the compiler vectorizes the
+// inlined loop for that instruction set regardless of the build flags.
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+ #define SPECULATOR_X86_KERNELS 1
+#else
+ #define SPECULATOR_X86_KERNELS 0
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+ #define SPECULATOR_KERNEL_BODY __forceinline
+ #define SPECULATOR_KEEP_LOOP
+#else
+ #define SPECULATOR_KERNEL_BODY inline __attribute__((always_inline))
+ #define SPECULATOR_KEEP_LOOP _Pragma("GCC unroll 1")
+#endif
+
+namespace DSPKernels
+{
+namespace
+{
+    namespace Body
+    {
+        SPECULATOR_KERNEL_BODY void convolveAccumulate(float* out, const float* input, const float* taps, int numTaps, int numSamples)
+        {
+            // Tap-outer loop, so the inner loop vectorizes across samples
+            for (int k = 0; k < numTaps; ++k)
+            {
+                const float tap = taps[k];
+                const float* delayed = input - k;
+                for (int i = 0; i < numSamples; ++i)
+                    out[i] += tap * delayed[i];
+            }
+        }
+
+        SPECULATOR_KERNEL_BODY void softClip(float* samples, int numSamples)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                samples[i] = DSPUtils::SoftClipper::processSample<DSPUtils::FastMath::Approx>(samples[i]);
+        }
+
+        SPECULATOR_KERNEL_BODY void accumulatePeak(float* peak, const float* input, int numSamples)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                peak[i] = std::max(peak[i], std::abs(input[i]));
+        }
+
+        SPECULATOR_KERNEL_BODY void slidingMaxPass(float* data, int span, int count)
+        {
+            for (int i = 0; i < count; ++i)
+                data[i] = std::max(data[i], data[i + span]);
+        }
+
+        SPECULATOR_KERNEL_BODY void multiply(float* dest, const float* source, const float* gains, int numSamples)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                dest[i] = source[i] * gains[i];
+        }
+
+        SPECULATOR_KERNEL_BODY void multiplyAndMix(float* mix, float* voice, const float* gains, int numSamples)
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                voice[i] *= gains[i];
+                mix[i] += voice[i];
+            }
+        }
+
+        // One group's lane state, held apart from the group so the compiler
+        // knows the source, the window and the output can't overwrite it
+        struct GrainLanes
+        {
+            alignas(32) int32_t start[GRAIN_LANES];
+            alignas(32) float offset[GRAIN_LANES];
+            alignas(32) float step[GRAIN_LANES];
+            alignas(32) uint32_t windowPhase[GRAIN_LANES];
+            alignas(32) uint32_t windowIncrement[GRAIN_LANES];
+            alignas(32) float gains[2][GRAIN_LANES];
+            alignas(32) int32_t begin[GRAIN_LANES];
+            alignas(32) int32_t end[GRAIN_LANES];
+            alignas(32) float contributions[2][GRAIN_LANES];
+        };
+
+        // Sample i of every lane, as one vector op per line across the
+        // grains. There are no branches: the source and window reads are
+        // gathers, the wrap is a select, and lanes that aren't playing or
+        // have run off the source read sample 0 and are weighted by zero.
+        // Offsets never go negative, so truncating is flooring.
+        template <bool Stereo, bool Looping>
+        SPECULATOR_KERNEL_BODY void renderGrainSample(GrainLanes& __restrict lanes, const float* __restrict left,
+                                                      const float* __restrict right, const float* __restrict window,
+                                                      int length, int i)
+        {
+            constexpr int fractionBits = 32 - DSPUtils::WindowTable::TABLE_BITS;
+            constexpr uint32_t fractionMask = (1u << fractionBits) - 1;
+            constexpr float fractionScale = 1.0f / (1u << fractionBits);
+
+            // Kept as a loop: unrolled, it leaves only the basic block
+            // vectorizer, which can't gather
+            SPECULATOR_KEEP_LOOP
+            for (int lane = 0; lane < GRAIN_LANES; ++lane)
+            {
+                const float offset = lanes.offset[lane];
+                const int32_t whole = static_cast<int32_t>(offset);
+                const float fraction = offset - static_cast<float>(whole);
+                int32_t index = lanes.start[lane] + whole;
+                int32_t next = index + 1;
+                if constexpr (Looping)
+                {
+                    index -= index >= length ? length : 0;
+                    next -= next >= length ? length : 0;
+                }
+
+                const int32_t inside = (static_cast<uint32_t>(index) < static_cast<uint32_t>(length))
+                                     & (static_cast<uint32_t>(next) < static_cast<uint32_t>(length));
+                const int32_t playing = (i >= lanes.begin[lane]) & (i < lanes.end[lane]);
+                index &= -inside;
+                next &= -inside;
+
+                const uint32_t windowPhase = lanes.windowPhase[lane];
+                const int32_t tableIndex = static_cast<int32_t>(windowPhase >> fractionBits);
+                const float windowFraction = static_cast<float>(static_cast<int32_t>(windowPhase & fractionMask)) * fractionScale;
+                const float windowGain = window[tableIndex] + windowFraction * (window[tableIndex + 1] - window[tableIndex]);
+                const float gain = (playing & inside) != 0 ? windowGain : 0.0f;
+
+                const float leftSample = (left[index] + fraction * (left[next] - left[index])) * gain;
+                lanes.contributions[0][lane] = leftSample * lanes.gains[0][lane];
+
+                if constexpr (Stereo)
+                    lanes.contributions[1][lane] = (right[index] + fraction * (right[next] - right[index])) * gain * lanes.gains[1][lane];
+                else
+                    lanes.contributions[1][lane] = leftSample * lanes.gains[1][lane];
+
+                lanes.offset[lane] = offset + (playing != 0 ? lanes.step[lane] : 0.0f);
+                lanes.windowPhase[lane] = windowPhase + (playing != 0 ? lanes.windowIncrement[lane] : 0u);
+            }
+        }
+
+        template <bool Stereo, bool Looping>
+        SPECULATOR_KERNEL_BODY void renderGrainLanes(GrainGroup& group, const GrainSource& source, float* const* out, int numSamples)
+        {
+            GrainLanes lanes;
+            for (int lane = 0; lane < GRAIN_LANES; ++lane)
+            {
+                lanes.start[lane] = group.start[lane];
+                lanes.offset[lane] = group.offset[lane];
+                lanes.step[lane] = group.step[lane];
+                lanes.windowPhase[lane] = group.windowPhase[lane];
+                lanes.windowIncrement[lane] = group.windowIncrement[lane];
+                lanes.gains[0][lane] = group.gains[0][lane];
+                lanes.gains[1][lane] = group.gains[1][lane];
+                lanes.begin[lane] = std::min(group.delay[lane], numSamples);
+                lanes.end[lane] = std::min(numSamples, group.delay[lane] + group.remaining[lane]);
+            }
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                renderGrainSample<Stereo, Looping>(lanes, source.channels[0], source.channels[1], source.window, source.length, i);
+
+                // Summed in lane order rather than as a tree, whatever the vector width
+                for (int channel = 0; channel < 2; ++channel)
+                {
+                    float sum = 0.0f;
+                    for (int lane = 0; lane < GRAIN_LANES; ++lane)
+                        sum += lanes.contributions[channel][lane];
+                    out[channel][i] += sum;
+                }
+            }
+
+            for (int lane = 0; lane < GRAIN_LANES; ++lane)
+            {
+                group.offset[lane] = lanes.offset[lane];
+                group.windowPhase[lane] = lanes.windowPhase[lane];
+                group.remaining[lane] -= lanes.end[lane] - lanes.begin[lane];
+                group.delay[lane] = std::max(0, group.delay[lane] - numSamples);
+            }
+        }
+
+        SPECULATOR_KERNEL_BODY void renderGrainGroup(GrainGroup& group, const GrainSource& source, float* const* out, int numSamples)
+        {
+            if (source.stereo && source.looping)
+                renderGrainLanes<true, true>(group, source, out, numSamples);
+            else if (source.stereo)
+                renderGrainLanes<true, false>(group, source, out, numSamples);
+            else if (source.looping)
+                renderGrainLanes<false, true>(group, source, out, numSamples);
+            else
+                renderGrainLanes<false, false>(group, source, out, numSamples);
+        }
+    }
+
+    // Stamps out one set of wrappers and its table for an ISA
+    #define SPECULATOR_DEFINE_KERNELS(Namespace, isaValue, TargetAttribute) \
+        namespace Namespace \
+        { \
+            TargetAttribute void convolveAccumulate(float* o, const float* x, const float* t, int k, int n) { Body::convolveAccumulate(o, x, t, k, n); } \
+            TargetAttribute void softClip(float* s, int n) { Body::softClip(s, n); } \
+            TargetAttribute void accumulatePeak(float* p, const float* x, int n) { Body::accumulatePeak(p, x, n); } \
+            TargetAttribute void slidingMaxPass(float* d, int s, int c) { Body::slidingMaxPass(d, s, c); } \
+            TargetAttribute void multiply(float* d, const float* s, const float* g, int n) { Body::multiply(d, s, g, n); } \
+            TargetAttribute void multiplyAndMix(float* m, float* v, const float* g, int n) { Body::multiplyAndMix(m, v, g, n); } \
+            TargetAttribute void renderGrainGroup(GrainGroup& gr, const GrainSource& s, float* const* o, int n) { Body::renderGrainGroup(gr, s, o, n); } \
+            \
+            const KernelTable table { isaValue, convolveAccumulate, softClip, accumulatePeak, \
+                                      slidingMaxPass, multiply, multiplyAndMix, renderGrainGroup }; \
+        }
+
+    SPECULATOR_DEFINE_KERNELS(Generic, ISA::Generic, )
+
+   #if SPECULATOR_X86_KERNELS
+    SPECULATOR_DEFINE_KERNELS(AVX2, ISA::AVX2, __attribute__((target("avx2,fma"))))
+    SPECULATOR_DEFINE_KERNELS(AVX512, ISA::AVX512, __attribute__((target("avx512f,avx2,fma"))))
+   #endif
+
+    #undef SPECULATOR_DEFINE_KERNELS
+}
+
+const char* getName(ISA isa)
+{
+    switch (isa)
+    {
+        case ISA::Generic: return "generic";
+        case ISA::AVX2:    return "avx2";
+        case ISA::AVX512:  return "avx512";
+        case ISA::NumISAs: break;
+    }
+
+    return "unknown";
+}
+
+ISA parseISA(const juce::String& name)
+{
+    for (int i = 0; i < static_cast<int>(ISA::NumISAs); ++i)
+    {
+        if (name.equalsIgnoreCase(getName(static_cast<ISA>(i))))
+            return static_cast<ISA>(i);
+    }
+
+    return ISA::NumISAs;
+}
+
+bool isCompiledIn(ISA isa)
+{
+    switch (isa)
+    {
+        case ISA::Generic: return true;
+        case ISA::AVX2:
+        case ISA::AVX512:  return SPECULATOR_X86_KERNELS != 0;
+        case ISA::NumISAs: break;
+    }
+
+    return false;
+}
+
+bool isSupported(ISA isa)
+{
+    if (!isCompiledIn(isa))
+        return false;
+
+    switch (isa)
+    {
+        case ISA::Generic: return true;
+        case ISA::AVX2:    return juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3();
+        case ISA::AVX512:  return juce::SystemStats::hasAVX512F() && juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3();
+        case ISA::NumISAs: break;
+    }
+
+    return false;
+}
+
+ISA detectBestISA()
+{
+    for (auto isa : { ISA::AVX512, ISA::AVX2 })
+    {
+        if (isSupported(isa))
+            return isa;
+    }
+
+    return ISA::Generic;
+}
+
+ISA getPreferredISA()
+{
+    // SPECULATOR_ISA=generic|avx2|avx512 pins the kernels, e.g. to compare variants
+    const auto requested = parseISA(juce::SystemStats::getEnvironmentVariable("SPECULATOR_ISA", {}));
+    if (requested != ISA::NumISAs && isSupported(requested))
+        return requested;
+
+    return detectBestISA();
+}
+
+const KernelTable& getTable(ISA isa)
+{
+    if (!isSupported(isa))
+        return Generic::table;
+
+    switch (isa)
+    {
+       #if SPECULATOR_X86_KERNELS
+        case ISA::AVX2:    return AVX2::table;
+        case ISA::AVX512:  return AVX512::table;
+       #endif
+        default:           break;
+    }
+
+    return Generic::table;
+}
+
+} // namespace DSPKernels
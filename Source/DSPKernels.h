@@ -0,0 +1,82 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+// Block kernels for the DSP core, compiled once per instruction set so a
+// single binary can use wide SIMD where the CPU has it: the halfband filters,
+// the clipper curve, the limiter, the voice mix and the cloud grains. Each
+// instance picks its table in prepareToPlay and hands it to its processors.
+// The per-voice resampler and window lookup and the IIR filters are not
+// here; they run per sample or recursively and stay on the baseline build.
+namespace DSPKernels {
+
+enum class ISA {
+    Generic,   // Whatever the build's baseline flags give (SSE2 on x86-64, NEON on arm64)
+    AVX2,      // AVX2 + FMA
+    AVX512,    // AVX-512F
+    NumISAs
+};
+
+// Cloud grains render in groups of this many, one grain per vector lane
+static constexpr int GRAIN_LANES = 8;
+
+// Lane-parallel state of one group of grains. Each lane reads its source at
+// start + offset with linear interpolation, under the window. A lane with
+// nothing remaining is free and plays silence.
+struct alignas(32) GrainGroup {
+    int32_t start[GRAIN_LANES];         // Source sample the grain started on
+    float offset[GRAIN_LANES];          // Read position from start, in samples
+    float step[GRAIN_LANES];
+    uint32_t windowPhase[GRAIN_LANES];  // Full range = one grain
+    uint32_t windowIncrement[GRAIN_LANES];
+    float gains[2][GRAIN_LANES];        // Per output channel
+    int32_t delay[GRAIN_LANES];         // Samples into the block before the grain starts
+    int32_t remaining[GRAIN_LANES];     // Samples left to play
+};
+
+struct GrainSource {
+    const float* channels[2] = {};  // A mono source gives its channel twice
+    bool stereo = false;
+    int length = 0;
+    bool looping = false;  // Reads past the end wrap once to the start instead of playing silence
+    const float* window = nullptr;  // WindowTable data
+};
+
+struct KernelTable {
+    ISA isa;
+
+    // out[i] += sum over k of taps[k] * input[i - k]; input needs numTaps - 1 samples of history
+    void (*convolveAccumulate)(float* out, const float* input, const float* taps, int numTaps, int numSamples);
+
+    // The soft clipper's static curve, in place
+    void (*softClip)(float* samples, int numSamples);
+
+    // peak[i] = max(peak[i], |input[i]|)
+    void (*accumulatePeak)(float* peak, const float* input, int numSamples);
+
+    // data[i] = max(data[i], data[i + span]) for i < count
+    void (*slidingMaxPass)(float* data, int span, int count);
+
+    // dest[i] = source[i] * gains[i]
+    void (*multiply)(float* dest, const float* source, const float* gains, int numSamples);
+
+    // voice[i] *= gains[i]; mix[i] += voice[i]
+    void (*multiplyAndMix)(float* mix, float* voice, const float* gains, int numSamples);
+
+    // Adds a group's grains to out[0] and out[1] and moves them on by numSamples
+    void (*renderGrainGroup)(GrainGroup& group, const GrainSource& source, float* const* out, int numSamples);
+};
+
+const char* getName(ISA isa);
+ISA parseISA(const juce::String& name);  // Returns NumISAs for unknown names
+
+bool isCompiledIn(ISA isa);
+bool isSupported(ISA isa);  // Compiled in and reported by the CPU
+ISA detectBestISA();
+
+// The best supported ISA, unless SPECULATOR_ISA names a supported one
+ISA getPreferredISA();
+
+const KernelTable& getTable(ISA isa);  // Falls back to Generic when unsupported
+
+} // namespace DSPKernels
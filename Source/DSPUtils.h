@@ -1,27 +1,134 @@
 #pragma once
 
 #include <juce_audio_basics/juce_audio_basics.h>
+#include "DSPArena.h"
+#include "DSPKernels.h"
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 namespace DSPUtils {
 
+// Bounded-error replacements for the libm calls on the hot path. Everything
+// here is branch-free (selects and bit tricks only) so loops over samples or
+// grains vectorize; GCC additionally needs -fno-trapping-math to if-convert
+// the clamps.
+//
+// Max errors over the float range: exp ~4e-6 relative, tanh ~2e-7 absolute,
+// sin/cos ~1.1e-7 absolute for |x| < 1e3 (reduction error grows with |x|).
+namespace FastMath {
+    inline float bitsToFloat(int32_t bits) {
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+    
+    inline int32_t floatToBits(float f) {
+        int32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        return bits;
+    }
+    
+    // Adding 1.5 * 2^23 rounds to the nearest integer and leaves it in the
+    // low mantissa bits, which avoids a (potentially trapping) float->int cast
+    static constexpr float ROUNDING_MAGIC = 12582912.0f;
+    static constexpr int32_t ROUNDING_MAGIC_BITS = 0x4b400000;
+    
+    inline float exp2(float x) {
+        x = std::min(127.0f, std::max(-126.0f, x));
+        const float shifted = x + ROUNDING_MAGIC;
+        const float f = x - (shifted - ROUNDING_MAGIC);  // [-0.5, 0.5]
+        
+        // Cephes exp2f minimax polynomial
+        const float p = 1.0f + f * (6.931472028e-1f + f * (2.402264791e-1f + f * (5.550332471e-2f
+                      + f * (9.618437357e-3f + f * (1.339887440e-3f + f * 1.535336188e-4f)))));
+        
+        return p * bitsToFloat((floatToBits(shifted) - ROUNDING_MAGIC_BITS + 127) << 23);
+    }
+    
+    inline float exp(float x) {
+        return exp2(x * 1.442695041f);
+    }
+    
+    inline float tanh(float x) {
+        // tanh saturates to 1 in float well before |x| = 9
+        x = std::min(9.0f, std::max(-9.0f, x));
+        const float e = exp(2.0f * x);
+        return (e - 1.0f) / (e + 1.0f);
+    }
+    
+    // cos(x - quadrantOffset * pi/2); the offset is applied after range
+    // reduction so sin() is as accurate as cos()
+    inline float shiftedCos(float x, int32_t quadrantOffset) {
+        // Reduce to [-pi/4, pi/4] around the nearest multiple of pi/2
+        // (Cody-Waite split of pi/2 keeps the reduction exact)
+        const float q = (x * 0.6366197724f + ROUNDING_MAGIC) - ROUNDING_MAGIC;
+        const float r = (x - q * 1.5703125f) - q * 4.8382679e-4f;
+        const int32_t quadrant = (floatToBits(q + ROUNDING_MAGIC) - ROUNDING_MAGIC_BITS - quadrantOffset) & 3;
+        
+        const float r2 = r * r;
+        const float s = r * (1.0f + r2 * (-0.1666666664f + r2 * (0.008333329f
+                      + r2 * (-1.9840874e-4f + r2 * 2.7525562e-6f))));
+        const float c = 1.0f + r2 * (-0.5f + r2 * (0.04166664f
+                      + r2 * (-0.0013888397f + r2 * 2.4760495e-5f)));
+        
+        // Odd quadrants use the sine polynomial, quadrants 1 and 2 are negative
+        const int32_t useSine = -(quadrant & 1);
+        const int32_t signFlip = ((quadrant + 1) & 2) << 30;
+        return bitsToFloat(((floatToBits(s) & useSine) | (floatToBits(c) & ~useSine)) ^ signFlip);
+    }
+    
+    inline float cos(float x) {
+        return shiftedCos(x, 0);
+    }
+    
+    inline float sin(float x) {
+        return shiftedCos(x, 1);
+    }
+    
+    // Math policies, so each call site can pick libm or the approximations
+    struct Std {
+        static float exp(float x) { return std::exp(x); }
+        static float tanh(float x) { return std::tanh(x); }
+        static float cos(float x) { return std::cos(x); }
+        static float sin(float x) { return std::sin(x); }
+    };
+    
+    struct Approx {
+        static float exp(float x) { return FastMath::exp(x); }
+        static float tanh(float x) { return FastMath::tanh(x); }
+        static float cos(float x) { return FastMath::cos(x); }
+        static float sin(float x) { return FastMath::sin(x); }
+    };
+} // namespace FastMath
+
 // High-quality sinc resampler
 class Resampler {
 public:
     static constexpr int SINC_POINTS = 8;
+    static constexpr int MAX_SINC_POINTS = 32;  // Offline; wider than SINC_POINTS gets a Blackman window
     
-    void prepare(double sampleRate) {
+    void prepare(double /*sampleRate*/) {
         buildKernel();
     }
     
+    // Half-width of the sinc, 1 .. MAX_SINC_POINTS; fewer points are cheaper and duller
+    void setNumPoints(int points) { numPoints = juce::jlimit(1, MAX_SINC_POINTS, points); }
+    int getNumPoints() const { return numPoints; }
+    
     float resample(const float* input, double position, int bufferSize) {
         const int pos = static_cast<int>(std::floor(position));
         const float frac = position - pos;
         
+        if (numPoints > SINC_POINTS)
+            return resampleWindowed(input, pos, position - pos, bufferSize);
+        
         float sum = 0.0f;
-        for (int i = -SINC_POINTS; i <= SINC_POINTS; ++i) {
+        for (int i = -numPoints; i <= numPoints; ++i) {
             const int readPos = pos + i;
             if (readPos >= 0 && readPos < bufferSize) {
                 sum += input[readPos] * sincInterpolate(frac - i);
@@ -37,9 +144,31 @@ private:
         return std::sin(px) / px;
     }
     
+    // A truncated sinc this long rings; the window tapers it to zero at the
+    // edges. Double precision, since it only runs offline.
+    float resampleWindowed(const float* input, int pos, double frac, int bufferSize) const {
+        const double halfWidth = numPoints + 1.0;
+        double sum = 0.0;
+        for (int i = -numPoints; i <= numPoints; ++i) {
+            const int readPos = pos + i;
+            if (readPos < 0 || readPos >= bufferSize)
+                continue;
+            
+            const double x = frac - i;
+            const double px = juce::MathConstants<double>::pi * x;
+            const double sinc = x == 0.0 ? 1.0 : std::sin(px) / px;
+            const double w = juce::MathConstants<double>::pi * (x / halfWidth);  // -pi .. pi across the span
+            const double window = 0.42 + 0.5 * std::cos(w) + 0.08 * std::cos(2.0 * w);
+            sum += input[readPos] * sinc * window;
+        }
+        return static_cast<float>(sum);
+    }
+    
     void buildKernel() {
         // Pre-calculate sinc kernel if needed
     }
+    
+    int numPoints = SINC_POINTS;
 };
 
 // 4th order Butterworth filter
@@ -50,10 +179,11 @@ public:
         reset();
     }
     
+    template <typename Math = FastMath::Approx>
     void setCutoff(float frequency) {
         const float omega = 2.0f * juce::MathConstants<float>::pi * frequency / fs;
-        const float cosOmega = std::cos(omega);
-        const float alpha = std::sin(omega) / 1.414213562f; // Q = 1/sqrt(2)
+        const float cosOmega = Math::cos(omega);
+        const float alpha = Math::sin(omega) / 1.414213562f; // Q = 1/sqrt(2)
         
         const float a0 = 1.0f + alpha;
         b[0] = (1.0f - cosOmega) / (2.0f * a0);
@@ -75,6 +205,25 @@ public:
         return output;
     }
     
+    // Same recurrence as process(float), with the state held in locals
+    void process(float* samples, int numSamples) {
+        const float b0 = b[0], b1 = b[1], b2 = b[2], a1 = a[1], a2 = a[2];
+        float x1 = x[1], x2 = x[2], y1 = y[1], y2 = y[2];
+        
+        for (int i = 0; i < numSamples; ++i) {
+            const float input = samples[i];
+            const float output = b0 * input + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+            x2 = x1;
+            x1 = input;
+            y2 = y1;
+            y1 = output;
+            samples[i] = output;
+        }
+        
+        x[1] = x1; x[2] = x2;
+        y[1] = y1; y[2] = y2;
+    }
+    
     void reset() {
         std::fill(x.begin(), x.end(), 0.0f);
         std::fill(y.begin(), y.end(), 0.0f);
@@ -98,6 +247,18 @@ public:
         return output;
     }
     
+    void process(float* samples, int numSamples) {
+        float xPrev = x1, yPrev = y1;
+        for (int i = 0; i < numSamples; ++i) {
+            const float input = samples[i];
+            yPrev = input - xPrev + R * yPrev;
+            xPrev = input;
+            samples[i] = yPrev;
+        }
+        x1 = xPrev;
+        y1 = yPrev;
+    }
+    
     void reset() {
         x1 = y1 = 0.0f;
     }
@@ -110,9 +271,20 @@ private:
 // Improved window function for grains
 class GrainWindow {
 public:
+    enum class Shape {
+        Classic,         // Hann with squared edges, shaped by overlap
+        Hann,
+        Tukey,           // Flat top with cosine tapers, shaped by overlap
+        Gaussian,
+        Trapezoid,       // Flat top with linear ramps, shaped by overlap
+        BlackmanHarris,
+        NumShapes
+    };
+    
+    template <typename Math = FastMath::Approx>
     static float getGainAt(float phase, float overlap = 0.5f) {
         // Enhanced window combining Hann and exponential edges
-        const float hann = 0.5f * (1.0f - std::cos(2.0f * juce::MathConstants<float>::pi * phase));
+        const float hann = 0.5f * (1.0f - Math::cos(2.0f * juce::MathConstants<float>::pi * phase));
         
         // Add exponential edges for smoother transitions
         const float edgeWidth = (1.0f - overlap) * 0.5f;
@@ -127,49 +299,417 @@ public:
         
         return hann;
     }
+    
+    // Exact (libm) evaluation of any shape, used to fill WindowTable
+    static float evaluate(Shape shape, float phase, float overlap) {
+        const double twoPi = juce::MathConstants<double>::twoPi;
+        const double edgeWidth = (1.0 - overlap) * 0.5;
+        const double distanceToEdge = std::min<double>(phase, 1.0 - phase);
+        
+        switch (shape) {
+            case Shape::Classic:
+                return getGainAt<FastMath::Std>(phase, overlap);
+                
+            case Shape::Hann:
+                return static_cast<float>(0.5 * (1.0 - std::cos(twoPi * phase)));
+                
+            case Shape::Tukey:
+                if (distanceToEdge >= edgeWidth)
+                    return 1.0f;
+                return static_cast<float>(0.5 * (1.0 - std::cos(juce::MathConstants<double>::pi * distanceToEdge / edgeWidth)));
+                
+            case Shape::Gaussian: {
+                // sigma = 1/6 of the grain, offset and rescaled so the ends
+                // reach exactly zero instead of stepping at about -39 dB
+                const double x = (phase - 0.5) * 6.0;
+                const double endValue = std::exp(-4.5);
+                return static_cast<float>((std::exp(-0.5 * x * x) - endValue) / (1.0 - endValue));
+            }
+                
+            case Shape::Trapezoid:
+                return static_cast<float>(std::min(1.0, distanceToEdge / edgeWidth));
+                
+            case Shape::BlackmanHarris:
+                return static_cast<float>(0.35875 - 0.48829 * std::cos(twoPi * phase)
+                                        + 0.14128 * std::cos(2.0 * twoPi * phase)
+                                        - 0.01168 * std::cos(3.0 * twoPi * phase));
+                
+            case Shape::NumShapes:
+                break;
+        }
+        
+        return 0.0f;
+    }
 };
 
-// Improved soft clipper with oversampling
-class SoftClipper {
+// Precomputed grain window, read with linear interpolation. Build it outside
+// the audio thread (prepareToPlay); lookups are branch-free table reads.
+class WindowTable {
 public:
-    void prepare(double sampleRate) {
-        filter.prepare(sampleRate * OVERSAMPLE);
-        filter.setCutoff(sampleRate * 0.45f); // Nyquist - small margin
+    static constexpr int TABLE_BITS = 10;
+    static constexpr int TABLE_SIZE = 1 << TABLE_BITS;
+    
+    void build(GrainWindow::Shape shape, float overlap) {
+        // One guard point so the interpolation never reads past the end
+        table.resize(TABLE_SIZE + 1);
+        for (int i = 0; i <= TABLE_SIZE; ++i)
+            table[i] = GrainWindow::evaluate(shape, static_cast<float>(i) / TABLE_SIZE, overlap);
     }
     
-    float process(float input) {
-        // Oversample
-        float oversampled[OVERSAMPLE];
-        for (int i = 0; i < OVERSAMPLE; ++i) {
-            oversampled[i] = input;
+    // phase in [0, 1]
+    float getGainAt(float phase) const {
+        const float position = std::min(1.0f, std::max(0.0f, phase)) * TABLE_SIZE;
+        const int index = std::min(TABLE_SIZE - 1, static_cast<int>(position));
+        const float frac = position - index;
+        return table[index] + frac * (table[index + 1] - table[index]);
+    }
+    
+    // Integer phase accumulator, the full uint32 range spanning one grain
+    float getGainAt(uint32_t phase) const {
+        const uint32_t index = phase >> (32 - TABLE_BITS);
+        const float frac = static_cast<float>(phase & ((1u << (32 - TABLE_BITS)) - 1)) * (1.0f / (1u << (32 - TABLE_BITS)));
+        return table[index] + frac * (table[index + 1] - table[index]);
+    }
+    
+    static uint32_t getPhaseIncrement(double grainLengthInSamples) {
+        return static_cast<uint32_t>(std::min(4294967295.0, 4294967296.0 / std::max(1.0, grainLengthInSamples)));
+    }
+    
+    // TABLE_SIZE + 1 points, for kernels that do their own lookups
+    const float* data() const { return table.data(); }
+    
+private:
+    std::vector<float> table;
+};
+
+// Independent xorshift32 generators side by side, one per lane, so filling a
+// block with random numbers is a handful of vector ops per LANES values.
+// Not for anything that needs more than audio-grade randomness.
+class LaneRandom {
+public:
+    static constexpr int LANES = 8;
+    
+    void setSeed(uint64_t seed) {
+        // SplitMix64 spreads one seed over the lanes; xorshift needs non-zero states
+        for (auto& state : states) {
+            seed += 0x9e3779b97f4a7c15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            state = static_cast<uint32_t>(z ^ (z >> 31)) | 1u;
+        }
+    }
+    
+    // dest[i] uniform in [-1, 1)
+    void fillBipolar(float* dest, int count) {
+        for (int done = 0; done < count; done += LANES) {
+            std::array<float, LANES> values;
+            for (int lane = 0; lane < LANES; ++lane) {
+                uint32_t state = states[lane];
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                states[lane] = state;
+                
+                // The top 23 bits as a mantissa give [1, 2)
+                values[lane] = FastMath::bitsToFloat(static_cast<int32_t>((state >> 9) | 0x3f800000u)) * 2.0f - 3.0f;
+            }
+            std::copy_n(values.begin(), std::min(LANES, count - done), dest + done);
+        }
+    }
+    
+private:
+    std::array<uint32_t, LANES> states{ 1, 2, 3, 4, 5, 6, 7, 8 };
+};
+
+// Float work buffer carved from a DSPArena when one is given, otherwise owned
+class FloatBlock {
+public:
+    void allocate(size_t size, DSPArena* arena, float initialValue = 0.0f) {
+        if (arena != nullptr) {
+            owned.clear();
+            owned.shrink_to_fit();
+            memory = arena->allocate<float>(size);
+        } else {
+            owned.resize(size);
+            memory = owned.data();
+        }
+        count = size;
+        fill(initialValue);
+    }
+    
+    void fill(float value) { std::fill(begin(), end(), value); }
+    
+    float* data() { return memory; }
+    const float* data() const { return memory; }
+    float* begin() { return memory; }
+    float* end() { return memory + count; }
+    size_t size() const { return count; }
+    
+private:
+    std::vector<float> owned;
+    float* memory = nullptr;
+    size_t count = 0;
+};
+
+// Polyphase halfband lowpass for 2x up/downsampling. Apart from the 0.5
+// centre tap only every other tap is non-zero, so a stage costs BRANCH_TAPS
+// multiply-adds per low-rate sample. Kaiser windowed, ~80 dB stopband with
+// the passband reaching ~0.41 of the low sample rate.
+struct HalfbandCoefficients {
+    static constexpr int BRANCH_TAPS = 32;
+    static constexpr int NUM_TAPS = 2 * BRANCH_TAPS - 1;
+    
+    // Delay through one up or down stage, in samples at the high rate
+    static constexpr int STAGE_DELAY = BRANCH_TAPS - 1;
+    
+    // Non-zero off-centre taps h[2k], k = 0 .. BRANCH_TAPS - 1
+    static const std::array<float, BRANCH_TAPS>& get() {
+        static const std::array<float, BRANCH_TAPS> taps = design();
+        return taps;
+    }
+    
+private:
+    static double besselI0(double x) {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; ++k) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
         }
+        return sum;
+    }
+    
+    static std::array<float, BRANCH_TAPS> design() {
+        constexpr double beta = 8.0;
+        constexpr int centre = BRANCH_TAPS - 1;
+        const int length = 2 * BRANCH_TAPS - 1;
         
-        // Process each oversampled point
-        for (int i = 0; i < OVERSAMPLE; ++i) {
-            oversampled[i] = processSample(oversampled[i]);
-            oversampled[i] = filter.process(oversampled[i]);
+        std::array<double, BRANCH_TAPS> taps{};
+        double sum = 0.0;
+        for (int k = 0; k < BRANCH_TAPS; ++k) {
+            const double offset = 2 * k - centre;  // always odd
+            const double x = juce::MathConstants<double>::pi * offset * 0.5;
+            const double ratio = 2.0 * (2 * k) / (length - 1) - 1.0;
+            const double window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) / besselI0(beta);
+            taps[k] = 0.5 * std::sin(x) / x * window;
+            sum += taps[k];
         }
         
-        // Average back to original sample rate
-        float sum = 0.0f;
-        for (int i = 0; i < OVERSAMPLE; ++i) {
-            sum += oversampled[i];
+        // Unity gain at DC: the branch taps and the 0.5 centre tap sum to 1
+        std::array<float, BRANCH_TAPS> normalised{};
+        for (int k = 0; k < BRANCH_TAPS; ++k)
+            normalised[k] = static_cast<float>(taps[k] * 0.5 / sum);
+        return normalised;
+    }
+};
+
+// 2x upsampler: numSamples in, 2 * numSamples out
+class HalfbandUpsampler {
+public:
+    void prepare(int maxBlockSize, DSPArena* arena = nullptr) {
+        work.allocate(static_cast<size_t>(HISTORY + maxBlockSize), arena);
+        accumulator.allocate(static_cast<size_t>(maxBlockSize), arena);
+    }
+    
+    void reset() {
+        work.fill(0.0f);
+    }
+    
+    void copyStateFrom(const HalfbandUpsampler& other) {
+        std::copy_n(other.work.data(), HISTORY, work.data());
+    }
+    
+    void setKernels(const DSPKernels::KernelTable& table) {
+        kernels = &table;
+    }
+    
+    void process(const float* input, float* output, int numSamples) {
+        const auto& h = HalfbandCoefficients::get();
+        float* x = work.data() + HISTORY;  // x[-HISTORY .. -1] is the previous block
+        float* acc = accumulator.data();
+        std::copy(input, input + numSamples, x);
+        
+        std::fill(acc, acc + numSamples, 0.0f);
+        kernels->convolveAccumulate(acc, x, h.data(), BRANCH, numSamples);
+        
+        for (int n = 0; n < numSamples; ++n) {
+            output[2 * n] = 2.0f * acc[n];
+            output[2 * n + 1] = x[n - BRANCH / 2 + 1];  // 2 * centre tap
+        }
+        
+        std::copy(x + numSamples - HISTORY, x + numSamples, work.begin());
+    }
+    
+private:
+    static constexpr int BRANCH = HalfbandCoefficients::BRANCH_TAPS;
+    static constexpr int HISTORY = BRANCH - 1;
+    FloatBlock work, accumulator;
+    const DSPKernels::KernelTable* kernels = &DSPKernels::getTable(DSPKernels::ISA::Generic);
+};
+
+// 2x decimator: 2 * numSamples in, numSamples out
+class HalfbandDownsampler {
+public:
+    void prepare(int maxBlockSize, DSPArena* arena = nullptr) {
+        evenWork.allocate(static_cast<size_t>(EVEN_HISTORY + maxBlockSize), arena);
+        oddWork.allocate(static_cast<size_t>(ODD_HISTORY + maxBlockSize), arena);
+    }
+    
+    void reset() {
+        evenWork.fill(0.0f);
+        oddWork.fill(0.0f);
+    }
+    
+    void copyStateFrom(const HalfbandDownsampler& other) {
+        std::copy_n(other.evenWork.data(), EVEN_HISTORY, evenWork.data());
+        std::copy_n(other.oddWork.data(), ODD_HISTORY, oddWork.data());
+    }
+    
+    void setKernels(const DSPKernels::KernelTable& table) {
+        kernels = &table;
+    }
+    
+    void process(const float* input, float* output, int numSamples) {
+        const auto& h = HalfbandCoefficients::get();
+        float* even = evenWork.data() + EVEN_HISTORY;
+        float* odd = oddWork.data() + ODD_HISTORY;
+        
+        for (int n = 0; n < numSamples; ++n) {
+            even[n] = input[2 * n];
+            odd[n] = input[2 * n + 1];
         }
         
-        return sum / OVERSAMPLE;
+        for (int n = 0; n < numSamples; ++n)
+            output[n] = 0.5f * odd[n - ODD_HISTORY];
+        
+        kernels->convolveAccumulate(output, even, h.data(), BRANCH, numSamples);
+        
+        std::copy(even + numSamples - EVEN_HISTORY, even + numSamples, evenWork.begin());
+        std::copy(odd + numSamples - ODD_HISTORY, odd + numSamples, oddWork.begin());
     }
     
 private:
-    static constexpr int OVERSAMPLE = 4;
-    ButterworthFilter filter;
+    static constexpr int BRANCH = HalfbandCoefficients::BRANCH_TAPS;
+    static constexpr int EVEN_HISTORY = BRANCH - 1;
+    static constexpr int ODD_HISTORY = BRANCH / 2;
+    FloatBlock evenWork, oddWork;
+    const DSPKernels::KernelTable* kernels = &DSPKernels::getTable(DSPKernels::ISA::Generic);
+};
+
+// Soft clipper run at 1x, 2x or 4x through cascaded halfband stages, so
+// the harmonics it generates are filtered before coming back down
+class SoftClipper {
+public:
+    static constexpr int MAX_STAGES = 2;  // 4x
     
-    float processSample(float x) {
+    void prepare(double /*sampleRate*/, int maxBlockSize, DSPArena* arena = nullptr) {
+        for (int stage = 0; stage < MAX_STAGES; ++stage) {
+            upsamplers[stage].prepare(maxBlockSize << stage, arena);
+            downsamplers[stage].prepare(maxBlockSize << stage, arena);
+        }
+        
+        oversampled.allocate(static_cast<size_t>(maxBlockSize) << MAX_STAGES, arena);
+        intermediate.allocate(static_cast<size_t>(maxBlockSize) << (MAX_STAGES - 1), arena);
+        reset();
+    }
+    
+    void reset() {
+        for (int stage = 0; stage < MAX_STAGES; ++stage) {
+            upsamplers[stage].reset();
+            downsamplers[stage].reset();
+        }
+    }
+    
+    // Takes on another clipper's factor and filter history, e.g. to carry on
+    // where one running the same signal left off
+    void copyStateFrom(const SoftClipper& other) {
+        numStages = other.numStages;
+        for (int stage = 0; stage < MAX_STAGES; ++stage) {
+            upsamplers[stage].copyStateFrom(other.upsamplers[stage]);
+            downsamplers[stage].copyStateFrom(other.downsamplers[stage]);
+        }
+    }
+    
+    void setKernels(const DSPKernels::KernelTable& table) {
+        kernels = &table;
+        for (int stage = 0; stage < MAX_STAGES; ++stage) {
+            upsamplers[stage].setKernels(table);
+            downsamplers[stage].setKernels(table);
+        }
+    }
+    
+    // 1, 2 or 4
+    void setOversamplingFactor(int factor) {
+        const int newStages = factor >= 4 ? 2 : (factor >= 2 ? 1 : 0);
+        if (newStages != numStages) {
+            numStages = newStages;
+            reset();
+        }
+    }
+    
+    int getOversamplingFactor() const { return 1 << numStages; }
+    
+    // Delay added by the up/down stages, in samples at the base rate
+    float getLatencyInSamples() const {
+        return getLatencyForFactor(getOversamplingFactor());
+    }
+    
+    static float getLatencyForFactor(int factor) {
+        const int stages = factor >= 4 ? 2 : (factor >= 2 ? 1 : 0);
+        float latency = 0.0f;
+        for (int stage = 0; stage < stages; ++stage)
+            latency += static_cast<float>(HalfbandCoefficients::STAGE_DELAY) * 2.0f / static_cast<float>(2 << stage);
+        return latency;
+    }
+    
+    // In place, numSamples no larger than the prepared block size
+    template <typename Math = FastMath::Approx>
+    void process(float* samples, int numSamples) {
+        if (numStages == 0) {
+            if constexpr (std::is_same_v<Math, FastMath::Approx>) {
+                kernels->softClip(samples, numSamples);
+            } else {
+                for (int i = 0; i < numSamples; ++i)
+                    samples[i] = processSample<Math>(samples[i]);
+            }
+            return;
+        }
+        
+        float* stage1 = numStages == 2 ? intermediate.data() : oversampled.data();
+        upsamplers[0].process(samples, stage1, numSamples);
+        if (numStages == 2)
+            upsamplers[1].process(stage1, oversampled.data(), numSamples * 2);
+        
+        const int numOversampled = numSamples << numStages;
+        float* data = oversampled.data();
+        if constexpr (std::is_same_v<Math, FastMath::Approx>) {
+            kernels->softClip(data, numOversampled);
+        } else {
+            for (int i = 0; i < numOversampled; ++i)
+                data[i] = processSample<Math>(data[i]);
+        }
+        
+        if (numStages == 2)
+            downsamplers[1].process(oversampled.data(), intermediate.data(), numSamples * 2);
+        downsamplers[0].process(stage1, samples, numSamples);
+    }
+    
+    // The static curve, without oversampling
+    template <typename Math = FastMath::Approx>
+    static float processSample(float x) {
         // Multi-stage soft clipping
-        x *= 0.686;  // Adjust input gain
-        x = std::tanh(x);
-        x = std::copysign(1.0f - std::exp(-std::abs(x)), x);
+        x *= 0.686f;  // Adjust input gain
+        x = Math::tanh(x);
+        x = std::copysign(1.0f - Math::exp(-std::abs(x)), x);
         return x;
     }
+    
+private:
+    int numStages = 1;
+    std::array<HalfbandUpsampler, MAX_STAGES> upsamplers;
+    std::array<HalfbandDownsampler, MAX_STAGES> downsamplers;
+    FloatBlock oversampled, intermediate;
+    const DSPKernels::KernelTable* kernels = &DSPKernels::getTable(DSPKernels::ISA::Generic);
 };
 
 // Limiter for peak control
@@ -194,6 +734,17 @@ public:
         return input * gain;
     }
     
+    void process(float* samples, int numSamples) {
+        float env = envelope;
+        for (int i = 0; i < numSamples; ++i) {
+            const float inputAbs = std::abs(samples[i]);
+            const float coefficient = inputAbs > env ? attackTime : releaseTime;
+            env = coefficient * (env - inputAbs) + inputAbs;
+            samples[i] *= env > threshold ? threshold / env : 1.0f;
+        }
+        envelope = env;
+    }
+    
     void reset() {
         envelope = 0.0f;
     }
@@ -205,4 +756,131 @@ private:
     float threshold = 0.95f;
 };
 
+// Channel-linked lookahead limiter. The audio is delayed by the lookahead
+// and every channel gets the same gain, which reaches its minimum exactly
+// as the loudest peak in the window comes out, so nothing clips through.
+class LookaheadLimiter {
+public:
+    static constexpr double LOOKAHEAD_SECONDS = 0.002;
+    
+    static int getLatencyForSampleRate(double sampleRate) {
+        return std::max(1, static_cast<int>(std::ceil(LOOKAHEAD_SECONDS * sampleRate)));
+    }
+    
+    void prepare(double sampleRate, int maxBlockSize, int maxChannels, DSPArena* arena = nullptr) {
+        lookahead = getLatencyForSampleRate(sampleRate);
+        blockSize = std::max(1, maxBlockSize);
+        releaseCoefficient = static_cast<float>(1.0 - std::exp(-1.0 / (0.100 * sampleRate)));
+        
+        const auto stride = static_cast<size_t>(lookahead + blockSize);
+        peaks.allocate(stride, arena);
+        windowMax.allocate(stride, arena);
+        smoothed.allocate(stride, arena);
+        delayLines.allocate(stride * static_cast<size_t>(std::max(1, maxChannels)), arena);
+        reset();
+    }
+    
+    void reset() {
+        peaks.fill(0.0f);
+        smoothed.fill(1.0f);
+        delayLines.fill(0.0f);
+        
+        envelope = 1.0f;
+        smoothedSum = static_cast<double>(lookahead);
+    }
+    
+    int getLatencyInSamples() const { return lookahead; }
+    
+    void setKernels(const DSPKernels::KernelTable& table) {
+        kernels = &table;
+    }
+    
+    // Processes channels in place; numChannels must not exceed the prepared count
+    void process(float* const* channels, int numChannels, int numSamples) {
+        for (int start = 0; start < numSamples; start += blockSize) {
+            const int count = std::min(blockSize, numSamples - start);
+            processChunk(channels, numChannels, start, count);
+        }
+    }
+    
+private:
+    void processChunk(float* const* channels, int numChannels, int offset, int numSamples) {
+        const int window = lookahead + 1;
+        float* peak = peaks.data() + lookahead;  // peak[-lookahead .. -1] is the previous chunk
+        
+        // Linked peak detector: loudest channel per sample
+        std::fill(peak, peak + numSamples, 0.0f);
+        for (int channel = 0; channel < numChannels; ++channel)
+            kernels->accumulatePeak(peak, channels[channel] + offset, numSamples);
+        
+        // Sliding max over the window by doubling spans, every pass vectorizes:
+        // after the pass with span s, windowMax[i] is the max of peaks[i .. i + 2s - 1]
+        float* maxima = windowMax.data();
+        std::copy(peaks.begin(), peaks.begin() + lookahead + numSamples, maxima);
+        
+        int span = 1, valid = lookahead + numSamples;
+        for (; 2 * span <= window; span *= 2) {
+            valid -= span;
+            kernels->slidingMaxPass(maxima, span, valid);
+        }
+        
+        // Two overlapping power-of-two spans cover the whole window
+        float* gain = smoothed.data() + lookahead;
+        for (int i = 0; i < numSamples; ++i) {
+            const float held = std::max(maxima[i], maxima[i + window - span]);
+            gain[i] = held > threshold ? threshold / held : 1.0f;
+        }
+        
+        // Instant attack, exponential release
+        float env = envelope;
+        for (int i = 0; i < numSamples; ++i) {
+            env = std::min(gain[i], env + releaseCoefficient * (gain[i] - env));
+            gain[i] = env;
+        }
+        envelope = env;
+        
+        // Moving average over the lookahead turns the gain steps into ramps that
+        // finish as the peak leaves the delay line. Overwrites gain in place, so
+        // the raw values are read back from the copy in windowMax.
+        std::copy(gain, gain + numSamples, maxima);
+        const float scale = 1.0f / static_cast<float>(lookahead);
+        double sum = smoothedSum;
+        for (int i = 0; i < numSamples; ++i) {
+            const float leaving = i >= lookahead ? maxima[i - lookahead] : gain[i - lookahead];
+            sum += static_cast<double>(maxima[i]) - static_cast<double>(leaving);
+            gain[i] = static_cast<float>(sum) * scale;
+        }
+        smoothedSum = sum;
+        
+        for (int channel = 0; channel < numChannels; ++channel) {
+            float* line = delayLines.data() + static_cast<size_t>(channel) * static_cast<size_t>(lookahead + blockSize);
+            float* samples = channels[channel] + offset;
+            
+            std::copy(samples, samples + numSamples, line + lookahead);
+            kernels->multiply(samples, line, gain, numSamples);
+            std::copy(line + numSamples, line + numSamples + lookahead, line);
+        }
+        
+        // Keep the last lookahead samples of peaks and unsmoothed gain for the next chunk
+        std::copy(peaks.begin() + numSamples, peaks.begin() + numSamples + lookahead, peaks.begin());
+        if (numSamples >= lookahead) {
+            std::copy(maxima + numSamples - lookahead, maxima + numSamples, smoothed.begin());
+        } else {
+            std::copy(smoothed.begin() + numSamples, smoothed.begin() + lookahead, smoothed.begin());
+            std::copy(maxima, maxima + numSamples, smoothed.begin() + (lookahead - numSamples));
+        }
+    }
+    
+    int lookahead = 0;
+    int blockSize = 1;
+    float threshold = 0.95f;
+    float releaseCoefficient = 0.0f;
+    float envelope = 1.0f;
+    double smoothedSum = 0.0;
+    
+    FloatBlock peaks, windowMax, smoothed;
+    FloatBlock delayLines;  // One lookahead + blockSize stretch per channel
+    const DSPKernels::KernelTable* kernels = &DSPKernels::getTable(DSPKernels::ISA::Generic);
+};
+
 } // namespace DSPUtils 
\ No newline at end of file
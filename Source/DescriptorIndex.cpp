@@ -0,0 +1,256 @@
+#include "DescriptorIndex.h"
+#include <juce_dsp/juce_dsp.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+DescriptorIndex::DescriptorIndex() : BackgroundIndex("Descriptor Index")
+{
+}
+
+DescriptorIndex::~DescriptorIndex()
+{
+    cancel();
+}
+
+void DescriptorIndex::buildIndex(const juce::AudioBuffer<float>& source, double sampleRate, uint32_t sourceVersion)
+{
+    const int numChannels = source.getNumChannels();
+    const int length = source.getNumSamples();
+    if (numChannels == 0 || length == 0)
+        return;
+
+    // Frames are described from the channels' average
+    std::vector<float> mix(source.getReadPointer(0), source.getReadPointer(0) + length);
+    for (int channel = 1; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::add(mix.data(), source.getReadPointer(channel), length);
+    juce::FloatVectorOperations::multiply(mix.data(), 1.0f / numChannels, length);
+
+    // Zero padded to twice the frame, so the autocorrelation taken from the
+    // power spectrum doesn't wrap around
+    constexpr int fftOrder = 12;
+    constexpr int fftSize = 1 << fftOrder;
+    static_assert(fftSize == 2 * FRAME_SIZE, "The FFT holds a frame and as much padding");
+    juce::dsp::FFT fft(fftOrder);
+
+    std::vector<float> window(static_cast<size_t>(FRAME_SIZE));
+    for (int i = 0; i < FRAME_SIZE; ++i)
+        window[static_cast<size_t>(i)] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * i / FRAME_SIZE);
+
+    const int minLag = std::max(2, static_cast<int>(sampleRate / MAX_FREQUENCY));
+    const int maxLag = std::min(FRAME_SIZE / 2, static_cast<int>(std::ceil(sampleRate / MIN_FREQUENCY)));
+
+    // The window's own autocorrelation, which the frame's is divided by so
+    // longer lags aren't penalised for the taper
+    std::vector<float> windowCorrelation(static_cast<size_t>(maxLag + 2));
+    for (int lag = 0; lag <= maxLag + 1; ++lag)
+    {
+        double sum = 0.0;
+        for (int i = 0; i + lag < FRAME_SIZE; ++i)
+            sum += static_cast<double>(window[static_cast<size_t>(i)]) * window[static_cast<size_t>(i + lag)];
+        windowCorrelation[static_cast<size_t>(lag)] = static_cast<float>(sum);
+    }
+    for (int lag = maxLag + 1; lag > 0; --lag)
+        windowCorrelation[static_cast<size_t>(lag)] /= windowCorrelation[0];
+    windowCorrelation[0] = 1.0f;
+
+    const float binHz = static_cast<float>(sampleRate / fftSize);
+    const float brightnessScale = 1.0f / std::log2(MAX_BRIGHTNESS_HZ / MIN_BRIGHTNESS_HZ);
+    const auto brightness = [&](float hz)
+    {
+        return juce::jlimit(0.0f, 1.0f, std::log2(std::max(hz, MIN_BRIGHTNESS_HZ) / MIN_BRIGHTNESS_HZ) * brightnessScale);
+    };
+
+    std::vector<float> spectrum(static_cast<size_t>(2 * fftSize));
+    std::vector<float> correlation(static_cast<size_t>(maxLag + 2));
+    auto built = std::make_unique<Tree>();
+    built->sourceVersion = sourceVersion;
+
+    const int numFrames = length > FRAME_SIZE ? (length - FRAME_SIZE) / HOP_SIZE + 1 : 1;
+    for (int f = 0; f < numFrames; ++f)
+    {
+        if (threadShouldExit())
+            return;
+
+        const int start = f * HOP_SIZE;
+        const int available = std::min(FRAME_SIZE, length - start);
+        const float* frame = mix.data() + start;
+
+        double energy = 0.0;
+        int crossings = 0;
+        for (int i = 0; i < available; ++i)
+        {
+            energy += static_cast<double>(frame[i]) * frame[i];
+            crossings += i > 0 && (frame[i - 1] < 0.0f) != (frame[i] < 0.0f) ? 1 : 0;
+        }
+
+        const float level = 10.0f * std::log10(static_cast<float>(energy / FRAME_SIZE) + std::numeric_limits<float>::min());
+        if (level < SILENCE_DB)
+            continue;
+
+        std::fill(spectrum.begin(), spectrum.end(), 0.0f);
+        for (int i = 0; i < available; ++i)
+            spectrum[static_cast<size_t>(i)] = frame[i] * window[static_cast<size_t>(i)];
+        fft.performRealOnlyForwardTransform(spectrum.data(), true);
+
+        // Centroid from the magnitudes, flatness from the power, and the power
+        // left in place for the autocorrelation
+        double weightedSum = 0.0, magnitudeSum = 0.0, logPowerSum = 0.0, powerSum = 0.0;
+        constexpr double powerFloor = 1.0e-12;
+        for (int bin = 0; bin <= fftSize / 2; ++bin)
+        {
+            const float re = spectrum[static_cast<size_t>(2 * bin)];
+            const float im = spectrum[static_cast<size_t>(2 * bin + 1)];
+            const double power = static_cast<double>(re) * re + static_cast<double>(im) * im;
+            const double magnitude = std::sqrt(power);
+
+            if (bin > 0)
+            {
+                weightedSum += bin * magnitude;
+                magnitudeSum += magnitude;
+                logPowerSum += std::log(power + powerFloor);
+                powerSum += power + powerFloor;
+            }
+
+            spectrum[static_cast<size_t>(2 * bin)] = static_cast<float>(power);
+            spectrum[static_cast<size_t>(2 * bin + 1)] = 0.0f;
+        }
+
+        const int numBins = fftSize / 2;
+        const float centroid = magnitudeSum > 0.0 ? static_cast<float>(weightedSum / magnitudeSum) * binHz : 0.0f;
+        const float flatness = static_cast<float>(std::exp(logPowerSum / numBins) / (powerSum / numBins));
+
+        fft.performRealOnlyInverseTransform(spectrum.data());
+
+        // The period is the shortest lag within a tenth of the best normalised
+        // correlation, which keeps multiples of it from winning
+        float note = 0.0f;
+        const float zeroLag = spectrum[0];
+        if (zeroLag > 0.0f)
+        {
+            float best = 0.0f;
+            for (int lag = minLag - 1; lag <= maxLag + 1; ++lag)
+            {
+                correlation[static_cast<size_t>(lag)] = spectrum[static_cast<size_t>(lag)] / (zeroLag * windowCorrelation[static_cast<size_t>(lag)]);
+                if (lag >= minLag && lag <= maxLag)
+                    best = std::max(best, correlation[static_cast<size_t>(lag)]);
+            }
+
+            if (best >= VOICING)
+            {
+                int lag = minLag;
+                while (lag < maxLag && (correlation[static_cast<size_t>(lag)] < 0.9f * best
+                       || correlation[static_cast<size_t>(lag + 1)] > correlation[static_cast<size_t>(lag)]))
+                    ++lag;
+
+                const float before = correlation[static_cast<size_t>(lag - 1)];
+                const float at = correlation[static_cast<size_t>(lag)];
+                const float after = correlation[static_cast<size_t>(lag + 1)];
+                const float curvature = before - 2.0f * at + after;
+                const float shift = curvature < 0.0f ? juce::jlimit(-0.5f, 0.5f, 0.5f * (before - after) / curvature) : 0.0f;
+                const double frequency = sampleRate / (lag + shift);
+                note = static_cast<float>(juce::jlimit(0.0, 127.0, 69.0 + 12.0 * std::log2(frequency / 440.0)));
+            }
+        }
+
+        Entry entry;
+        entry.frame.position = start;
+        entry.frame.note = note;
+        entry.point[static_cast<size_t>(Descriptor::Loudness)] = juce::jlimit(0.0f, 1.0f, 1.0f - level / SILENCE_DB);
+        entry.point[static_cast<size_t>(Descriptor::Brightness)] = brightness(centroid);
+        entry.point[static_cast<size_t>(Descriptor::Noisiness)] = juce::jlimit(0.0f, 1.0f, flatness);
+        entry.point[static_cast<size_t>(Descriptor::Pitch)] = note / 127.0f;
+        entry.point[static_cast<size_t>(Descriptor::ZeroCrossingRate)] = available > 1 ? brightness(0.5f * static_cast<float>(sampleRate) * crossings / (available - 1)) : 0.0f;
+        built->entries.push_back(entry);
+    }
+
+    built->axes.resize(built->entries.size());
+    buildTree(*built, 0, static_cast<int>(built->entries.size()));
+
+    tree.publish(std::move(built));
+}
+
+void DescriptorIndex::buildTree(Tree& tree, int begin, int end)
+{
+    if (end - begin < 1)
+        return;
+
+    // Split on the descriptor that spreads furthest across the range
+    Point low, high;
+    low.fill(std::numeric_limits<float>::max());
+    high.fill(std::numeric_limits<float>::lowest());
+    for (int i = begin; i < end; ++i)
+    {
+        for (size_t d = 0; d < NUM_DESCRIPTORS; ++d)
+        {
+            low[d] = std::min(low[d], tree.entries[static_cast<size_t>(i)].point[d]);
+            high[d] = std::max(high[d], tree.entries[static_cast<size_t>(i)].point[d]);
+        }
+    }
+
+    size_t axis = 0;
+    for (size_t d = 1; d < NUM_DESCRIPTORS; ++d)
+    {
+        if (high[d] - low[d] > high[axis] - low[axis])
+            axis = d;
+    }
+
+    const int median = begin + (end - begin) / 2;
+    std::nth_element(tree.entries.begin() + begin, tree.entries.begin() + median, tree.entries.begin() + end,
+                     [axis](const Entry& a, const Entry& b) { return a.point[axis] < b.point[axis]; });
+    tree.axes[static_cast<size_t>(median)] = static_cast<uint8_t>(axis);
+
+    buildTree(tree, begin, median);
+    buildTree(tree, median + 1, end);
+}
+
+void DescriptorIndex::search(const Tree& tree, int begin, int end, const Point& target, const Point& weights,
+                             int& nearest, float& nearestDistance)
+{
+    if (end - begin < 1)
+        return;
+
+    const int median = begin + (end - begin) / 2;
+    const auto& point = tree.entries[static_cast<size_t>(median)].point;
+
+    float distance = 0.0f;
+    for (size_t d = 0; d < NUM_DESCRIPTORS; ++d)
+        distance += weights[d] * (point[d] - target[d]) * (point[d] - target[d]);
+
+    if (distance < nearestDistance)
+    {
+        nearest = median;
+        nearestDistance = distance;
+    }
+
+    // The target's side of the split first; the other only while it could
+    // still hold something nearer
+    const size_t axis = tree.axes[static_cast<size_t>(median)];
+    const float offset = target[axis] - point[axis];
+    const bool lowerFirst = offset < 0.0f;
+
+    search(tree, lowerFirst ? begin : median + 1, lowerFirst ? median : end, target, weights, nearest, nearestDistance);
+    if (weights[axis] * offset * offset < nearestDistance)
+        search(tree, lowerFirst ? median + 1 : begin, lowerFirst ? end : median, target, weights, nearest, nearestDistance);
+}
+
+bool DescriptorIndex::isReady(uint32_t sourceVersion) const
+{
+    const auto* index = tree.get();
+    return index != nullptr && index->sourceVersion == sourceVersion && !index->entries.empty();
+}
+
+bool DescriptorIndex::findNearest(uint32_t sourceVersion, const Point& target, const Point& weights, Frame& frame) const
+{
+    if (!isReady(sourceVersion))
+        return false;
+
+    const auto* index = tree.get();
+
+    int nearest = 0;
+    float nearestDistance = std::numeric_limits<float>::max();
+    search(*index, 0, static_cast<int>(index->entries.size()), target, weights, nearest, nearestDistance);
+
+    frame = index->entries[static_cast<size_t>(nearest)].frame;
+    return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "BackgroundIndex.h"
+#include <array>
+#include <vector>
+
+// Short frames of the loaded sample, each described by a few cheap
+// descriptors, found on a background thread and kept in a k-d tree. The frame
+// nearest a target is then a logarithmic search with no scanning at render
+// time. Every descriptor is scaled to 0..1, so a single weighted distance
+// covers them all; silent frames are left out.
+class DescriptorIndex : public BackgroundIndex
+{
+public:
+    enum class Descriptor
+    {
+        Loudness,          // RMS level, over the 60 dB above SILENCE_DB
+        Brightness,        // Spectral centroid, on a log scale from 50 Hz to 16 kHz
+        Noisiness,         // Spectral flatness
+        Pitch,             // MIDI note over 127; 0 where unvoiced
+        ZeroCrossingRate,  // As the frequency of a sine crossing as often, on the brightness scale
+        NumDescriptors
+    };
+
+    static constexpr int NUM_DESCRIPTORS = static_cast<int>(Descriptor::NumDescriptors);
+    using Point = std::array<float, NUM_DESCRIPTORS>;
+
+    static constexpr int FRAME_SIZE = 2048;
+    static constexpr int HOP_SIZE = 512;
+
+    struct Frame
+    {
+        int position = 0;  // Source sample the frame starts at
+        float note = 0.0f;  // Fractional MIDI note; 0 where unvoiced
+    };
+
+    DescriptorIndex();
+    ~DescriptorIndex() override;
+
+    // Audio thread, between updates. Whether an index of that source version
+    // is in, with at least one frame.
+    bool isReady(uint32_t sourceVersion) const;
+
+    // Audio thread, between updates. The frame nearest target, each
+    // descriptor's squared difference scaled by its weight; false when there
+    // is no index of that source version yet, or the sample is all silence.
+    bool findNearest(uint32_t sourceVersion, const Point& target, const Point& weights, Frame& frame) const;
+
+private:
+    void buildIndex(const juce::AudioBuffer<float>& source, double sampleRate, uint32_t sourceVersion) override;
+    void pickUpIndex() override { tree.pickUp(); }
+
+    struct Entry
+    {
+        Point point{};
+        Frame frame;
+    };
+
+    // A balanced tree laid out in place: each range's median is its node,
+    // split on axes[median], with the lower half before it and the upper after
+    struct Tree
+    {
+        uint32_t sourceVersion = 0;
+        std::vector<Entry> entries;
+        std::vector<uint8_t> axes;
+    };
+
+    static void buildTree(Tree& tree, int begin, int end);
+    static void search(const Tree& tree, int begin, int end, const Point& target, const Point& weights,
+                       int& nearest, float& nearestDistance);
+
+    static constexpr float SILENCE_DB = -60.0f;
+    static constexpr float MIN_BRIGHTNESS_HZ = 50.0f;
+    static constexpr float MAX_BRIGHTNESS_HZ = 16000.0f;
+    static constexpr double MIN_FREQUENCY = 60.0;  // Pitch range, Hz
+    static constexpr double MAX_FREQUENCY = 1000.0;
+    static constexpr float VOICING = 0.6f;  // Normalised autocorrelation a voiced frame's period reaches
+
+    IndexHandoff<Tree> tree;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DescriptorIndex)
+};
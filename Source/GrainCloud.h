@@ -0,0 +1,166 @@
+#pragma once
+
+#include "DSPArena.h"
+#include "DSPKernels.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// One pool of grains shared by every voice in cloud mode, kept in lane groups
+// the batched renderer works through a group at a time. A group belongs to a
+// single voice while any of its grains play, so each voice renders only its
+// own groups and voices can still render on separate threads. Grains are
+// added and groups handed out on the audio thread before the voices render.
+class GrainCloud
+{
+public:
+    static constexpr int LANES = DSPKernels::GRAIN_LANES;
+    static constexpr int MAX_GRAINS = 1024;
+    static constexpr int NUM_GROUPS = MAX_GRAINS / LANES;
+
+    struct GrainStart
+    {
+        double position = 0.0;  // Source sample
+        float step = 1.0f;
+        int length = 0;  // Samples
+        uint32_t windowIncrement = 0;
+        std::array<float, 2> gains{ 1.0f, 1.0f };
+        int delay = 0;  // Samples into the block
+    };
+
+    // Inside the arena layout, so both passes carve the same size
+    void prepare(DSPArena& arena)
+    {
+        groups = arena.allocate<DSPKernels::GrainGroup>(NUM_GROUPS);
+        owners = arena.allocate<int>(NUM_GROUPS);
+        clear();
+    }
+
+    void setKernels(const DSPKernels::KernelTable& table)
+    {
+        kernels = &table;
+    }
+
+    void clear()
+    {
+        for (int group = 0; group < NUM_GROUPS && groups != nullptr; ++group)
+        {
+            groups[group] = DSPKernels::GrainGroup{};
+            owners[group] = FREE;
+        }
+    }
+
+    // Stops a voice's grains and returns its groups to the pool
+    void releaseVoice(int voice)
+    {
+        for (int group = 0; group < NUM_GROUPS && groups != nullptr; ++group)
+        {
+            if (owners[group] == voice)
+            {
+                groups[group] = DSPKernels::GrainGroup{};
+                owners[group] = FREE;
+            }
+        }
+    }
+
+    // Returns groups whose grains have all finished to the pool
+    void releaseFinished()
+    {
+        for (int group = 0; group < NUM_GROUPS && groups != nullptr; ++group)
+        {
+            const auto& lanes = groups[group];
+            if (owners[group] != FREE && std::all_of(lanes.remaining, lanes.remaining + LANES, [](int32_t r) { return r <= 0; }))
+                owners[group] = FREE;
+        }
+    }
+
+    // Grain samples the grains already playing will render this block
+    int getBlockCost(int numSamples) const
+    {
+        int cost = 0;
+        for (int group = 0; group < NUM_GROUPS && groups != nullptr; ++group)
+        {
+            if (owners[group] == FREE)
+                continue;
+
+            const auto& lanes = groups[group];
+            for (int lane = 0; lane < LANES; ++lane)
+                cost += std::max(0, std::min(lanes.remaining[lane], numSamples - lanes.delay[lane]));
+        }
+        return cost;
+    }
+
+    // Adds go to the voice's own groups first, then to free ones. The search
+    // carries on from the last add, so a block's worth of grains for one
+    // voice costs a single pass over the pool.
+    void beginAdding(int voice)
+    {
+        addingVoice = voice;
+        searchGroup = 0;
+        searchLane = 0;
+    }
+
+    // False once the pool is full
+    bool add(const GrainStart& grain)
+    {
+        for (; searchGroup < NUM_GROUPS && groups != nullptr; ++searchGroup, searchLane = 0)
+        {
+            if (owners[searchGroup] != addingVoice && owners[searchGroup] != FREE)
+                continue;
+
+            auto& lanes = groups[searchGroup];
+            for (; searchLane < LANES; ++searchLane)
+            {
+                if (lanes.remaining[searchLane] > 0)
+                    continue;
+
+                const int lane = searchLane++;
+                const double start = std::floor(grain.position);
+                owners[searchGroup] = addingVoice;
+                lanes.start[lane] = static_cast<int32_t>(start);
+                lanes.offset[lane] = static_cast<float>(grain.position - start);
+                lanes.step[lane] = grain.step;
+                lanes.windowPhase[lane] = 0;
+                lanes.windowIncrement[lane] = grain.windowIncrement;
+                lanes.gains[0][lane] = grain.gains[0];
+                lanes.gains[1][lane] = grain.gains[1];
+                lanes.delay[lane] = grain.delay;
+                lanes.remaining[lane] = grain.length;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Audio thread, any thread per voice. Adds the voice's grains into out.
+    void render(int voice, const DSPKernels::GrainSource& source, float* const* out, int numSamples)
+    {
+        for (int group = 0; group < NUM_GROUPS && groups != nullptr; ++group)
+        {
+            if (owners[group] == voice)
+                kernels->renderGrainGroup(groups[group], source, out, numSamples);
+        }
+    }
+
+    // Moves every grain's read position, e.g. as the live window slides
+    void shiftPositions(int shift)
+    {
+        for (int group = 0; group < NUM_GROUPS && groups != nullptr; ++group)
+        {
+            for (auto& start : groups[group].start)
+                start += shift;
+        }
+    }
+
+private:
+    static constexpr int FREE = -1;
+
+    DSPKernels::GrainGroup* groups = nullptr;
+    int* owners = nullptr;  // Voice index per group, or FREE
+    const DSPKernels::KernelTable* kernels = &DSPKernels::getTable(DSPKernels::ISA::Generic);
+
+    int addingVoice = FREE;
+    int searchGroup = 0;
+    int searchLane = 0;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <memory>
+
+// Passes an analysis index built on a background thread to the audio thread.
+// The builder publishes under a spin lock; the audio thread picks the newest
+// one up with a try-lock at the start of a block, before any voice renders,
+// then reads it without locking until its next pickup. Every voice in a
+// block sees the same index, whichever thread renders it. Indexes the audio
+// thread has let go of are freed by the next publish, never on the audio
+// thread.
+template <typename Index>
+class IndexHandoff
+{
+public:
+    // Builder thread
+    void publish(std::unique_ptr<Index> index)
+    {
+        {
+            const juce::SpinLock::ScopedLockType lock(swapLock);
+            std::swap(waiting, index);
+            hasWaiting = true;
+        }
+
+        // Whatever was waiting, or the index the audio thread last retired,
+        // is freed here, outside the lock
+    }
+
+    // Audio thread, at the start of a block
+    void pickUp()
+    {
+        const juce::SpinLock::ScopedTryLockType lock(swapLock);
+        if (lock.isLocked() && hasWaiting)
+        {
+            std::swap(current, waiting);
+            hasWaiting = false;
+        }
+    }
+
+    // Audio thread, any number of threads between pickups. Null until the first index arrives.
+    const Index* get() const { return current.get(); }
+
+private:
+    std::unique_ptr<Index> current;
+    std::unique_ptr<Index> waiting;
+    bool hasWaiting = false;
+    juce::SpinLock swapLock;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "DSPArena.h"
+#include "DSPUtils.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// The last few seconds of the plugin input, kept for the grain engine to read
+// in place. Every sample is written twice, one capacity apart, so the most
+// recent N samples are always one contiguous run and the resampler reads them
+// like a loaded sample, without wrapping.
+class LiveCapture
+{
+public:
+    static constexpr int NUM_CHANNELS = 2;
+    static constexpr float CAPACITY_SECONDS = 4.0f;
+
+    // Inside the arena layout, so both passes carve the same size
+    void prepare(double sampleRate, DSPArena& arena)
+    {
+        capacity = static_cast<int>(std::ceil(CAPACITY_SECONDS * sampleRate));
+        for (auto& channel : channels)
+            channel.allocate(static_cast<size_t>(capacity) * 2, &arena);
+        writeIndex = 0;
+    }
+
+    // Audio thread. A mono input fills both channels, no input records silence.
+    void write(const float* const* input, int numInputChannels, int numSamples)
+    {
+        for (int done = 0; done < numSamples && capacity > 0;)
+        {
+            const int count = std::min(numSamples - done, capacity - writeIndex);
+
+            for (int channel = 0; channel < NUM_CHANNELS; ++channel)
+            {
+                float* first = channels[static_cast<size_t>(channel)].data() + writeIndex;
+                float* mirror = first + capacity;
+
+                if (numInputChannels > 0)
+                {
+                    const float* source = input[std::min(channel, numInputChannels - 1)] + done;
+                    juce::FloatVectorOperations::copy(first, source, count);
+                    juce::FloatVectorOperations::copy(mirror, source, count);
+                }
+                else
+                {
+                    juce::FloatVectorOperations::clear(first, count);
+                    juce::FloatVectorOperations::clear(mirror, count);
+                }
+            }
+
+            writeIndex = writeIndex + count == capacity ? 0 : writeIndex + count;
+            done += count;
+        }
+    }
+
+    // The last length samples of a channel, oldest first; length <= capacity.
+    // Valid until the next write.
+    const float* getRecent(int channel, int length) const
+    {
+        return channels[static_cast<size_t>(channel)].data() + writeIndex + capacity - length;
+    }
+
+    int getCapacity() const { return capacity; }
+
+private:
+    std::array<DSPUtils::FloatBlock, NUM_CHANNELS> channels;
+    int capacity = 0;
+    int writeIndex = 0;  // Next sample to write, 0 .. capacity - 1
+};
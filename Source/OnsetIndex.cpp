@@ -0,0 +1,119 @@
+#include "OnsetIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+OnsetIndex::OnsetIndex() : BackgroundIndex("Onset Index")
+{
+}
+
+OnsetIndex::~OnsetIndex()
+{
+    cancel();
+}
+
+void OnsetIndex::buildIndex(const juce::AudioBuffer<float>& source, double sampleRate, uint32_t sourceVersion)
+{
+    const int numChannels = source.getNumChannels();
+    const int length = source.getNumSamples();
+    if (numChannels == 0 || length < 2)
+        return;
+
+    auto built = std::make_unique<Marks>();
+    built->sourceVersion = sourceVersion;
+    auto& zeroCrossings = built->positions[static_cast<size_t>(Mark::ZeroCrossing)];
+    auto& onsets = built->positions[static_cast<size_t>(Mark::Onset)];
+    auto& transients = built->positions[static_cast<size_t>(Mark::Transient)];
+
+    // Every mark is found on the channels' sum
+    std::vector<float> mix(source.getReadPointer(0), source.getReadPointer(0) + length);
+    for (int channel = 1; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::add(mix.data(), source.getReadPointer(channel), length);
+
+    const int numHops = length / HOP_SIZE;
+    std::vector<float> hopEnergy(static_cast<size_t>(numHops));
+    float loudestHop = 0.0f;
+
+    for (int hop = 0; hop < numHops; ++hop)
+    {
+        if (threadShouldExit())
+            return;
+
+        const int first = std::max(1, hop * HOP_SIZE);
+        const int last = (hop + 1) * HOP_SIZE;
+        float energy = 0.0f;
+
+        for (int i = first; i < last; ++i)
+        {
+            if (mix[i - 1] < 0.0f && mix[i] >= 0.0f)
+                zeroCrossings.push_back(static_cast<uint32_t>(i));
+
+            const float difference = mix[i] - mix[i - 1];
+            energy += difference * difference;
+        }
+
+        hopEnergy[static_cast<size_t>(hop)] = energy;
+        loudestHop = std::max(loudestHop, energy);
+    }
+
+    for (int i = std::max(1, numHops * HOP_SIZE); i < length; ++i)
+    {
+        if (mix[i - 1] < 0.0f && mix[i] >= 0.0f)
+            zeroCrossings.push_back(static_cast<uint32_t>(i));
+    }
+
+    // Log energy rise from one hop to the next; the gate keeps noise in near
+    // silence from counting
+    const float gate = loudestHop * GATE + std::numeric_limits<float>::min();
+    std::vector<float> rise(static_cast<size_t>(numHops), 0.0f);
+    for (int hop = 1; hop < numHops; ++hop)
+        rise[static_cast<size_t>(hop)] = std::log2((hopEnergy[static_cast<size_t>(hop)] + gate) / (hopEnergy[static_cast<size_t>(hop - 1)] + gate));
+
+    const int minGap = static_cast<int>(MIN_ONSET_GAP_SECONDS * sampleRate);
+    const int transientLength = std::max(1, static_cast<int>(TRANSIENT_SECONDS * sampleRate));
+
+    for (int hop = 1; hop < numHops; ++hop)
+    {
+        const float value = rise[static_cast<size_t>(hop)];
+        const bool isPeak = value >= rise[static_cast<size_t>(hop - 1)]
+                         && (hop + 1 == numHops || value > rise[static_cast<size_t>(hop + 1)]);
+        const int position = hop * HOP_SIZE;
+
+        if (value < MIN_RISE || !isPeak || (!onsets.empty() && position - static_cast<int>(onsets.back()) < minGap))
+            continue;
+
+        onsets.push_back(static_cast<uint32_t>(position));
+
+        const int end = std::min(length, position + transientLength);
+        const auto loudest = std::max_element(mix.begin() + position, mix.begin() + end,
+                                              [](float a, float b) { return std::abs(a) < std::abs(b); });
+        transients.push_back(static_cast<uint32_t>(loudest - mix.begin()));
+    }
+
+    marks.publish(std::move(built));
+}
+
+double OnsetIndex::findNearest(uint32_t sourceVersion, Mark mark, double position, double maxDistance) const
+{
+    const auto* index = marks.get();
+    if (index == nullptr || index->sourceVersion != sourceVersion)
+        return position;
+
+    const auto& positions = index->positions[static_cast<size_t>(mark)];
+    const auto after = std::lower_bound(positions.begin(), positions.end(), position,
+                                        [](uint32_t markPosition, double p) { return markPosition < p; });
+
+    double nearest = position;
+    double nearestDistance = maxDistance;
+
+    if (after != positions.end() && *after - position <= nearestDistance)
+    {
+        nearest = *after;
+        nearestDistance = *after - position;
+    }
+
+    if (after != positions.begin() && position - *(after - 1) <= nearestDistance)
+        nearest = *(after - 1);
+
+    return nearest;
+}
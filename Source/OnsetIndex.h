@@ -0,0 +1,54 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "BackgroundIndex.h"
+#include <array>
+#include <vector>
+
+// Sorted sample positions of the loaded sample's rising zero crossings,
+// onsets and transient peaks, found on a background thread after each load.
+// Grain starts are snapped to them with a binary search, so nothing is
+// scanned at render time.
+//
+// Onsets are hops where the energy of the first difference, which leans
+// towards the attack's high frequencies, jumps by more than MIN_RISE over the
+// hop before; each onset's transient is its loudest sample shortly after.
+class OnsetIndex : public BackgroundIndex
+{
+public:
+    enum class Mark
+    {
+        ZeroCrossing,
+        Onset,
+        Transient,
+        NumMarks
+    };
+
+    OnsetIndex();
+    ~OnsetIndex() override;
+
+    // Audio thread, between updates. The mark nearest position, if one is
+    // within maxDistance and the index is of that source version; otherwise
+    // position itself.
+    double findNearest(uint32_t sourceVersion, Mark mark, double position, double maxDistance) const;
+
+private:
+    void buildIndex(const juce::AudioBuffer<float>& source, double sampleRate, uint32_t sourceVersion) override;
+    void pickUpIndex() override { marks.pickUp(); }
+
+    struct Marks
+    {
+        uint32_t sourceVersion = 0;
+        std::array<std::vector<uint32_t>, static_cast<size_t>(Mark::NumMarks)> positions;
+    };
+
+    static constexpr int HOP_SIZE = 256;
+    static constexpr float MIN_RISE = 1.0f;  // Octaves of energy, so 3 dB
+    static constexpr float GATE = 1.0e-6f;  // Of the loudest hop's energy; quieter hops never start an onset
+    static constexpr double MIN_ONSET_GAP_SECONDS = 0.05;
+    static constexpr double TRANSIENT_SECONDS = 0.02;
+
+    IndexHandoff<Marks> marks;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OnsetIndex)
+};
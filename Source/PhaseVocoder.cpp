@@ -0,0 +1,190 @@
+#include "PhaseVocoder.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    constexpr float TWO_PI = juce::MathConstants<float>::twoPi;
+
+    // Squared Hann windows at four hops per frame sum to 1.5
+    constexpr float OVERLAP_GAIN = 1.0f / 1.5f;
+
+    // Bins quieter than this never count as peaks
+    constexpr float PEAK_FLOOR = 1.0e-6f;
+
+    float wrapPhase(float phase)
+    {
+        return phase - TWO_PI * std::round(phase / TWO_PI);
+    }
+}
+
+void PhaseVocoder::Workspace::allocate(DSPArena& arena)
+{
+    // Planning allocates, so it happens once, off the audio thread
+    if (fft == nullptr)
+        fft = std::make_unique<juce::dsp::FFT>(FFT_ORDER);
+
+    window.allocate(FFT_SIZE, &arena);
+    for (int i = 0; i < FFT_SIZE; ++i)
+        window.data()[i] = 0.5f - 0.5f * std::cos(TWO_PI * static_cast<float>(i) / FFT_SIZE);
+
+    frame.allocate(2 * FFT_SIZE, &arena);
+    magnitudes.allocate(NUM_BINS, &arena);
+    phases.allocate(NUM_BINS, &arena);
+    previousPhases.allocate(NUM_BINS, &arena);
+    frequencies.allocate(NUM_BINS, &arena);
+    peaks = arena.allocate<int>(NUM_BINS);
+}
+
+void PhaseVocoder::allocate(DSPArena& arena)
+{
+    for (auto& channel : overlap)
+        channel.allocate(FFT_SIZE, &arena);
+    for (auto& hop : synthesisPhases)
+        for (auto& channel : hop)
+            channel.allocate(NUM_BINS, &arena);
+    currentPhases = 0;
+    outputIndex = HOP_SIZE;
+}
+
+void PhaseVocoder::reset()
+{
+    for (auto& channel : overlap)
+        channel.fill(0.0f);
+    for (auto& hop : synthesisPhases)
+        for (auto& channel : hop)
+            channel.fill(0.0f);
+    currentPhases = 0;
+    outputIndex = HOP_SIZE;
+}
+
+void PhaseVocoder::analyseFrame(const Source& source, int channel, int start, Workspace& workspace, float* magnitudes, float* phases)
+{
+    const float* input = source.channels[channel];
+    const float* window = workspace.window.data();
+    float* frame = workspace.frame.data();
+
+    for (int i = 0; i < FFT_SIZE; ++i)
+    {
+        int index = start + i;
+        if (source.looping && source.length > 0)
+            index = ((index % source.length) + source.length) % source.length;
+
+        frame[i] = index >= 0 && index < source.length ? input[index] * window[i] : 0.0f;
+    }
+
+    std::fill(frame + FFT_SIZE, frame + 2 * FFT_SIZE, 0.0f);
+    workspace.fft->performRealOnlyForwardTransform(frame, true);
+
+    for (int bin = 0; bin < NUM_BINS; ++bin)
+    {
+        const float re = frame[2 * bin];
+        const float im = frame[2 * bin + 1];
+        magnitudes[bin] = std::sqrt(re * re + im * im);
+        phases[bin] = std::atan2(im, re);
+    }
+}
+
+void PhaseVocoder::measureFrequencies(const float* previousPhases, const float* phases, float* frequencies)
+{
+    for (int bin = 0; bin < NUM_BINS; ++bin)
+    {
+        const float expected = TWO_PI * static_cast<float>(bin) * HOP_SIZE / FFT_SIZE;
+        const float deviation = wrapPhase(phases[bin] - previousPhases[bin] - expected);
+        frequencies[bin] = (expected + deviation) / HOP_SIZE;  // Radians per sample
+    }
+}
+
+void PhaseVocoder::analyse(const Source& source, int channel, double position, Workspace& workspace)
+{
+    // Two frames a hop apart give each bin's instantaneous frequency, whether
+    // or not the analysis position moved by a hop. The earlier frame's
+    // magnitudes are overwritten by the later one's.
+    const int start = static_cast<int>(std::floor(position));
+    analyseFrame(source, channel, start - HOP_SIZE, workspace, workspace.magnitudes.data(), workspace.previousPhases.data());
+    analyseFrame(source, channel, start, workspace, workspace.magnitudes.data(), workspace.phases.data());
+    measureFrequencies(workspace.previousPhases.data(), workspace.phases.data(), workspace.frequencies.data());
+}
+
+void PhaseVocoder::synthesiseHop(const Source& source, double position, double pitchRatio, Workspace& workspace)
+{
+    for (int channel = 0; channel < std::min(source.numChannels, MAX_CHANNELS); ++channel)
+    {
+        analyse(source, channel, position, workspace);
+        synthesise(channel, pitchRatio, workspace);
+    }
+
+    finishHop();
+}
+
+void PhaseVocoder::synthesise(int channel, double pitchRatio, Workspace& workspace)
+{
+    const float* window = workspace.window.data();
+    const float* magnitudes = workspace.magnitudes.data();
+    const float* phases = workspace.phases.data();
+    const float* frequencies = workspace.frequencies.data();
+    int* peaks = workspace.peaks;
+
+    // Peaks are local maxima over two bins either side
+    int numPeaks = 0;
+    for (int bin = 2; bin < NUM_BINS - 2; ++bin)
+    {
+        const float magnitude = magnitudes[bin];
+        if (magnitude > PEAK_FLOOR && magnitude > magnitudes[bin - 1] && magnitude > magnitudes[bin - 2]
+            && magnitude >= magnitudes[bin + 1] && magnitude >= magnitudes[bin + 2])
+            peaks[numPeaks++] = bin;
+    }
+
+    // Each peak owns the bins up to halfway to its neighbours and moves them
+    // as one. The peak's phase advances from the last hop's at its shifted
+    // frequency and the rest of its region keeps the analysed offsets from
+    // it. Shifted regions can overlap, so the last hop's phases are read from
+    // their own array; bins no region reaches carry theirs over.
+    float* spectrum = workspace.frame.data();
+    const float* previousPhase = synthesisPhases[static_cast<size_t>(currentPhases ^ 1)][static_cast<size_t>(channel)].data();
+    float* synthesisPhase = synthesisPhases[static_cast<size_t>(currentPhases)][static_cast<size_t>(channel)].data();
+    std::fill(spectrum, spectrum + 2 * FFT_SIZE, 0.0f);
+    std::copy_n(previousPhase, NUM_BINS, synthesisPhase);
+
+    for (int i = 0; i < numPeaks; ++i)
+    {
+        const int peak = peaks[i];
+        const int shift = juce::roundToInt(peak * pitchRatio) - peak;
+        if (peak + shift >= NUM_BINS)
+            break;
+
+        const int low = i == 0 ? 0 : (peaks[i - 1] + peak + 1) / 2;
+        const int high = i == numPeaks - 1 ? NUM_BINS : (peak + peaks[i + 1] + 1) / 2;
+        const float peakPhase = previousPhase[peak + shift]
+                              + frequencies[peak] * static_cast<float>(pitchRatio) * HOP_SIZE;
+
+        for (int bin = std::max(low, -shift); bin < high && bin + shift < NUM_BINS; ++bin)
+        {
+            const float phase = wrapPhase(peakPhase + phases[bin] - phases[peak]);
+            spectrum[2 * (bin + shift)] += magnitudes[bin] * std::cos(phase);
+            spectrum[2 * (bin + shift) + 1] += magnitudes[bin] * std::sin(phase);
+            synthesisPhase[bin + shift] = phase;
+        }
+    }
+
+    workspace.fft->performRealOnlyInverseTransform(spectrum);
+
+    // Slide the finished hop out and add the new frame under the synthesis window
+    float* output = overlap[static_cast<size_t>(channel)].data();
+    std::memmove(output, output + HOP_SIZE, sizeof(float) * (FFT_SIZE - HOP_SIZE));
+    std::fill(output + FFT_SIZE - HOP_SIZE, output + FFT_SIZE, 0.0f);
+
+    for (int i = 0; i < FFT_SIZE; ++i)
+        output[i] += spectrum[i] * window[i] * OVERLAP_GAIN;
+}
+
+int PhaseVocoder::read(float* const* destination, int numChannels, int numSamples)
+{
+    const int count = std::min(numSamples, getNumReady());
+
+    for (int channel = 0; channel < std::min(numChannels, MAX_CHANNELS); ++channel)
+        std::copy_n(overlap[static_cast<size_t>(channel)].data() + outputIndex, count, destination[channel]);
+
+    outputIndex += count;
+    return count;
+}
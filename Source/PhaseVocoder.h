@@ -0,0 +1,83 @@
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include "DSPArena.h"
+#include "DSPUtils.h"
+#include <array>
+#include <memory>
+
+// Time-stretching and pitch-shifting phase vocoder with identity phase locking
+// (Laroche & Dolson): the bins around each spectral peak keep their analysed
+// phase offsets from it, which removes most of the phasiness of a plain
+// vocoder. Time and pitch are independent. The caller moves the analysis
+// position at whatever speed it likes, and the peaks are moved up or down the
+// spectrum by the pitch ratio. Every hop costs two forward and one inverse FFT
+// per channel, whatever the ratios.
+class PhaseVocoder
+{
+public:
+    static constexpr int FFT_ORDER = 11;
+    static constexpr int FFT_SIZE = 1 << FFT_ORDER;
+    static constexpr int HOP_SIZE = FFT_SIZE / 4;
+    static constexpr int NUM_BINS = FFT_SIZE / 2 + 1;
+    static constexpr int MAX_CHANNELS = 2;
+    
+    // The first hops after a reset overlap fewer frames and fade in; a sound
+    // analysed at the first hop reaches full level this many samples later
+    static constexpr int LATENCY = FFT_SIZE - HOP_SIZE;
+
+    // Per-hop scratch and the transform plan, planned once. Any vocoder
+    // rendering on the same thread can share one.
+    struct Workspace
+    {
+        void allocate(DSPArena& arena);
+
+        std::unique_ptr<juce::dsp::FFT> fft;
+        DSPUtils::FloatBlock window;  // Periodic Hann, for analysis and synthesis
+        DSPUtils::FloatBlock frame;  // 2 * FFT_SIZE, as the real-only transforms need
+        DSPUtils::FloatBlock magnitudes, phases, previousPhases, frequencies;  // NUM_BINS
+        int* peaks = nullptr;
+    };
+
+    struct Source
+    {
+        const float* const* channels = nullptr;
+        int numChannels = 1;
+        int length = 0;
+        bool looping = false;  // Frames wrap around the ends instead of reading silence
+    };
+
+    void allocate(DSPArena& arena);
+    void reset();
+
+    // Output left from the last hop; synthesise another once it runs out
+    int getNumReady() const { return HOP_SIZE - outputIndex; }
+
+    // Analyses the source frame starting at position, and the one a hop
+    // before it, and overlap-adds the next hop of every source channel
+    void synthesiseHop(const Source& source, double position, double pitchRatio, Workspace& workspace);
+    
+    // The same in steps, for analysis that comes from elsewhere: fill the
+    // workspace's magnitudes, phases and frequencies, synthesise each channel
+    // from them, then finish the hop
+    static void analyse(const Source& source, int channel, double position, Workspace& workspace);
+    void synthesise(int channel, double pitchRatio, Workspace& workspace);
+    void finishHop() { outputIndex = 0; currentPhases ^= 1; }
+    
+    // Building blocks of analyse: one windowed frame's spectrum, and each
+    // bin's instantaneous frequency from its phase a hop earlier
+    static void analyseFrame(const Source& source, int channel, int start, Workspace& workspace, float* magnitudes, float* phases);
+    static void measureFrequencies(const float* previousPhases, const float* phases, float* frequencies);
+
+    // Copies up to numSamples of the ready output into one pointer per source channel
+    int read(float* const* destination, int numChannels, int numSamples);
+
+private:
+    std::array<DSPUtils::FloatBlock, MAX_CHANNELS> overlap;  // FFT_SIZE; the first HOP_SIZE are finished
+    
+    // NUM_BINS per channel, for this hop and the last. Each hop reads the
+    // last one's while writing its own, and finishHop() swaps them.
+    std::array<std::array<DSPUtils::FloatBlock, MAX_CHANNELS>, 2> synthesisPhases;
+    int currentPhases = 0;
+    int outputIndex = HOP_SIZE;
+};
@@ -0,0 +1,182 @@
+#include "PitchMarkIndex.h"
+#include <juce_dsp/juce_dsp.h>
+#include <algorithm>
+#include <cmath>
+
+PitchMarkIndex::PitchMarkIndex() : BackgroundIndex("Pitch Marks")
+{
+}
+
+PitchMarkIndex::~PitchMarkIndex()
+{
+    cancel();
+}
+
+std::vector<float> PitchMarkIndex::trackPeriods(const std::vector<float>& mix, double sampleRate, int window, int hop)
+{
+    // Each frame compares the window with itself at every lag up to the
+    // window length, so it spans two windows. The difference function comes
+    // from one cross-correlation by FFT rather than a sum per lag.
+    const int length = static_cast<int>(mix.size());
+    const int frameLength = 2 * window;
+    const int fftOrder = juce::roundToInt(std::log2(window)) + 2;
+    const int fftSize = 1 << fftOrder;
+    juce::dsp::FFT fft(fftOrder);
+
+    const int minLag = std::max(2, static_cast<int>(sampleRate / MAX_FREQUENCY));
+    const int maxLag = std::min(window - 1, static_cast<int>(std::ceil(sampleRate / MIN_FREQUENCY)));
+
+    std::vector<float> frame(static_cast<size_t>(2 * fftSize));
+    std::vector<float> head(static_cast<size_t>(2 * fftSize));
+    std::vector<double> energy(static_cast<size_t>(frameLength + 1));
+    std::vector<float> difference(static_cast<size_t>(maxLag + 2));
+
+    const int numFrames = length / hop + 1;
+    std::vector<float> periods(static_cast<size_t>(numFrames), 0.0f);
+
+    for (int f = 0; f < numFrames; ++f)
+    {
+        if (threadShouldExit())
+            return {};
+
+        const int start = f * hop;
+        const int available = std::max(0, std::min(frameLength, length - start));
+        std::fill(frame.begin(), frame.end(), 0.0f);
+        std::fill(head.begin(), head.end(), 0.0f);
+        std::copy_n(mix.begin() + start, available, frame.begin());
+        std::copy_n(frame.begin(), window, head.begin());
+
+        // Running energy, for each lag's window
+        energy[0] = 0.0;
+        for (int i = 0; i < frameLength; ++i)
+            energy[static_cast<size_t>(i + 1)] = energy[static_cast<size_t>(i)] + static_cast<double>(frame[static_cast<size_t>(i)]) * frame[static_cast<size_t>(i)];
+
+        const double headEnergy = energy[static_cast<size_t>(window)];
+        if (headEnergy < SILENCE * window)
+            continue;
+
+        // r(lag) = sum over the window of x[i] * x[i + lag], as conj(H) * F
+        fft.performRealOnlyForwardTransform(frame.data(), true);
+        fft.performRealOnlyForwardTransform(head.data(), true);
+        for (int bin = 0; bin <= fftSize / 2; ++bin)
+        {
+            const float fr = frame[static_cast<size_t>(2 * bin)], fi = frame[static_cast<size_t>(2 * bin + 1)];
+            const float hr = head[static_cast<size_t>(2 * bin)], hi = head[static_cast<size_t>(2 * bin + 1)];
+            frame[static_cast<size_t>(2 * bin)] = hr * fr + hi * fi;
+            frame[static_cast<size_t>(2 * bin + 1)] = hr * fi - hi * fr;
+        }
+        fft.performRealOnlyInverseTransform(frame.data());
+
+        // Cumulative mean normalised difference
+        double runningSum = 0.0;
+        difference[0] = 1.0f;
+        for (int lag = 1; lag <= maxLag + 1; ++lag)
+        {
+            const double lagEnergy = energy[static_cast<size_t>(lag + window)] - energy[static_cast<size_t>(lag)];
+            const double d = std::max(0.0, headEnergy + lagEnergy - 2.0 * frame[static_cast<size_t>(lag)]);
+            runningSum += d;
+            difference[static_cast<size_t>(lag)] = runningSum > 0.0 ? static_cast<float>(d * lag / runningSum) : 1.0f;
+        }
+
+        // The first dip under the threshold, followed to the bottom
+        int lag = minLag;
+        while (lag <= maxLag && difference[static_cast<size_t>(lag)] >= THRESHOLD)
+            ++lag;
+        if (lag > maxLag)
+            continue;
+        while (lag < maxLag && difference[static_cast<size_t>(lag + 1)] < difference[static_cast<size_t>(lag)])
+            ++lag;
+
+        // Parabolic interpolation of the minimum
+        const float before = difference[static_cast<size_t>(lag - 1)];
+        const float at = difference[static_cast<size_t>(lag)];
+        const float after = difference[static_cast<size_t>(lag + 1)];
+        const float curvature = before - 2.0f * at + after;
+        const float shift = curvature > 0.0f ? juce::jlimit(-0.5f, 0.5f, 0.5f * (before - after) / curvature) : 0.0f;
+        periods[static_cast<size_t>(f)] = static_cast<float>(lag) + shift;
+    }
+
+    return periods;
+}
+
+void PitchMarkIndex::buildIndex(const juce::AudioBuffer<float>& source, double sampleRate, uint32_t sourceVersion)
+{
+    const int numChannels = source.getNumChannels();
+    const int length = source.getNumSamples();
+    if (numChannels == 0 || length == 0)
+        return;
+
+    // Marks are found on the channels' sum and shared by them
+    std::vector<float> mix(source.getReadPointer(0), source.getReadPointer(0) + length);
+    for (int channel = 1; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::add(mix.data(), source.getReadPointer(channel), length);
+
+    const int window = juce::nextPowerOfTwo(static_cast<int>(std::ceil(sampleRate / MIN_FREQUENCY)) + 1);
+    const int hop = std::max(1, static_cast<int>(HOP_SECONDS * sampleRate));
+    const auto periods = trackPeriods(mix, sampleRate, window, hop);
+    if (periods.empty())
+        return;
+
+    // A frame's period belongs to the middle of its first window
+    const auto periodAt = [&](int position)
+    {
+        const int frame = juce::jlimit(0, static_cast<int>(periods.size()) - 1, juce::roundToInt((position - window / 2) / static_cast<double>(hop)));
+        return periods[static_cast<size_t>(frame)];
+    };
+
+    auto built = std::make_unique<Marks>();
+    built->sourceVersion = sourceVersion;
+
+    const float unvoicedSpacing = std::max(1.0f, static_cast<float>(UNVOICED_SECONDS * sampleRate));
+    bool wasVoiced = false;
+
+    // position is where the next mark is expected
+    for (int position = 0; position < length;)
+    {
+        const float period = periodAt(position);
+        int mark = position;
+        float markPeriod = unvoicedSpacing;
+
+        if (period > 0.0f)
+        {
+            // A voiced run continues on the peak nearest a period on; a new
+            // one starts on the highest peak of its first period
+            const int reach = std::max(1, juce::roundToInt(period * (wasVoiced ? 0.25f : 1.0f)));
+            const int first = juce::jlimit(0, length - 1, wasVoiced ? position - reach : position);
+            const int last = juce::jlimit(first + 1, length, position + reach);
+            mark = static_cast<int>(std::max_element(mix.begin() + first, mix.begin() + last) - mix.begin());
+            markPeriod = period;
+        }
+
+        if (!built->positions.empty() && mark <= static_cast<int>(built->positions.back()))
+            mark = static_cast<int>(built->positions.back()) + 1;
+        if (mark >= length)
+            break;
+
+        built->positions.push_back(static_cast<uint32_t>(mark));
+        built->periods.push_back(markPeriod);
+        position = mark + std::max(1, juce::roundToInt(markPeriod));
+        wasVoiced = period > 0.0f;
+    }
+
+    marks.publish(std::move(built));
+}
+
+bool PitchMarkIndex::findNearest(uint32_t sourceVersion, double position, Mark& mark) const
+{
+    const auto* index = marks.get();
+    if (index == nullptr || index->sourceVersion != sourceVersion || index->positions.empty())
+        return false;
+
+    const auto& positions = index->positions;
+    auto nearest = std::lower_bound(positions.begin(), positions.end(), position,
+                                    [](uint32_t markPosition, double p) { return markPosition < p; });
+
+    if (nearest == positions.end() || (nearest != positions.begin() && position - *(nearest - 1) < *nearest - position))
+        --nearest;
+
+    const auto i = static_cast<size_t>(nearest - positions.begin());
+    mark.position = static_cast<int>(positions[i]);
+    mark.period = index->periods[i];
+    return true;
+}
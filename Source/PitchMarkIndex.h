@@ -0,0 +1,52 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "BackgroundIndex.h"
+#include <vector>
+
+// Pitch marks of the loaded sample for pitch-synchronous overlap-add, found
+// on a background thread. A YIN tracker (de Cheveigné & Kawahara) measures
+// the period every hop; through voiced stretches a mark is placed on the
+// waveform peak nearest each period, and through unvoiced ones every
+// UNVOICED_SECONDS. The render side only ever looks marks up.
+class PitchMarkIndex : public BackgroundIndex
+{
+public:
+    struct Mark
+    {
+        int position = 0;  // Source sample
+        float period = 0.0f;  // Samples; the fixed spacing where unvoiced
+    };
+
+    PitchMarkIndex();
+    ~PitchMarkIndex() override;
+
+    // Audio thread, between updates. The mark nearest position; false when
+    // there is no index of that source version yet.
+    bool findNearest(uint32_t sourceVersion, double position, Mark& mark) const;
+
+private:
+    void buildIndex(const juce::AudioBuffer<float>& source, double sampleRate, uint32_t sourceVersion) override;
+    void pickUpIndex() override { marks.pickUp(); }
+
+    // One period estimate per hop, 0 where unvoiced
+    std::vector<float> trackPeriods(const std::vector<float>& mix, double sampleRate, int window, int hop);
+
+    struct Marks
+    {
+        uint32_t sourceVersion = 0;
+        std::vector<uint32_t> positions;
+        std::vector<float> periods;
+    };
+
+    static constexpr double MIN_FREQUENCY = 60.0;  // Hz
+    static constexpr double MAX_FREQUENCY = 1000.0;
+    static constexpr double HOP_SECONDS = 0.005;
+    static constexpr double UNVOICED_SECONDS = 0.005;
+    static constexpr float THRESHOLD = 0.15f;  // Of the normalised difference; dips below it are periods
+    static constexpr float SILENCE = 1.0e-8f;  // Mean square below which a window is unvoiced
+
+    IndexHandoff<Marks> marks;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PitchMarkIndex)
+};
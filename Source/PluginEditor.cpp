@@ -40,6 +40,21 @@ SondyQ2AudioProcessorEditor::SondyQ2AudioProcessorEditor(SondyQ2AudioProcessor&
     modeButton->addListener(this);
     addAndMakeVisible(modeButton.get());
     
+    windowButton = std::make_unique<juce::TextButton>("Win: Classic");
+    windowButton->addListener(this);
+    addAndMakeVisible(windowButton.get());
+    
+    // Live granulation of the plugin input, and freezing what it has captured
+    liveButton = std::make_unique<juce::TextButton>("Live: OFF");
+    liveButton->setClickingTogglesState(true);
+    liveButton->addListener(this);
+    addAndMakeVisible(liveButton.get());
+    
+    freezeButton = std::make_unique<juce::TextButton>("Freeze");
+    freezeButton->setClickingTogglesState(true);
+    freezeButton->addListener(this);
+    addAndMakeVisible(freezeButton.get());
+    
     speedSlider = std::make_unique<juce::Slider>(juce::Slider::SliderStyle::LinearHorizontal, 
                                                juce::Slider::TextEntryBoxPosition::TextBoxRight);
     speedSlider->setRange(0.1, 4.0, 0.01);
@@ -125,7 +140,7 @@ void SondyQ2AudioProcessorEditor::resized()
     // Calculate button widths based on available space
     int availableWidth = buttonArea.getWidth();
     int buttonSpacing = spacing;
-    int numButtons = 5;  // loadButton, loopButton, holdButton, stopButton, modeButton
+    int numButtons = 8;  // loadButton, loopButton, holdButton, stopButton, modeButton, windowButton, liveButton, freezeButton
     int buttonWidth = (availableWidth - (buttonSpacing * (numButtons - 1))) / numButtons;
     
     // Layout controls with proportional widths
@@ -142,6 +157,15 @@ void SondyQ2AudioProcessorEditor::resized()
     buttonArea.removeFromLeft(buttonSpacing);
     
     modeButton->setBounds(buttonArea.removeFromLeft(buttonWidth));
+    buttonArea.removeFromLeft(buttonSpacing);
+    
+    windowButton->setBounds(buttonArea.removeFromLeft(buttonWidth));
+    buttonArea.removeFromLeft(buttonSpacing);
+    
+    liveButton->setBounds(buttonArea.removeFromLeft(buttonWidth));
+    buttonArea.removeFromLeft(buttonSpacing);
+    
+    freezeButton->setBounds(buttonArea.removeFromLeft(buttonWidth));
     
     // Leave space for sliders
     area.removeFromTop(spacing);
@@ -193,6 +217,22 @@ void SondyQ2AudioProcessorEditor::buttonClicked(juce::Button* button)
         audioProcessor.cyclePlaybackMode();
         updateModeButtonText();
     }
+    else if (button == windowButton.get())
+    {
+        audioProcessor.cycleWindowShape();
+        updateWindowButtonText();
+    }
+    else if (button == liveButton.get())
+    {
+        if (auto* samplePlayer = audioProcessor.getSamplePlayer())
+            samplePlayer->setLiveInput(liveButton->getToggleState());
+        updateLiveButtonText();
+    }
+    else if (button == freezeButton.get())
+    {
+        if (auto* samplePlayer = audioProcessor.getSamplePlayer())
+            samplePlayer->setLiveFrozen(freezeButton->getToggleState());
+    }
 }
 
 void SondyQ2AudioProcessorEditor::sliderValueChanged(juce::Slider* slider)
@@ -285,6 +325,12 @@ void SondyQ2AudioProcessorEditor::updateHoldButtonText()
     holdButton->setButtonText(isHoldMode ? "Hold: ON" : "Hold: OFF");
 }
 
+void SondyQ2AudioProcessorEditor::updateLiveButtonText()
+{
+    bool isLive = liveButton->getToggleState();
+    liveButton->setButtonText(isLive ? "Live: ON" : "Live: OFF");
+}
+
 void SondyQ2AudioProcessorEditor::updateModeButtonText()
 {
     if (auto* samplePlayer = audioProcessor.getSamplePlayer())
@@ -306,6 +352,38 @@ void SondyQ2AudioProcessorEditor::updateModeButtonText()
     }
 }
 
+void SondyQ2AudioProcessorEditor::updateWindowButtonText()
+{
+    if (auto* samplePlayer = audioProcessor.getSamplePlayer())
+    {
+        juce::String windowText = "Win: ";
+        switch (samplePlayer->getWindowShape())
+        {
+            case DSPUtils::GrainWindow::Shape::Classic:
+                windowText += "Classic";
+                break;
+            case DSPUtils::GrainWindow::Shape::Hann:
+                windowText += "Hann";
+                break;
+            case DSPUtils::GrainWindow::Shape::Tukey:
+                windowText += "Tukey";
+                break;
+            case DSPUtils::GrainWindow::Shape::Gaussian:
+                windowText += "Gauss";
+                break;
+            case DSPUtils::GrainWindow::Shape::Trapezoid:
+                windowText += "Trap";
+                break;
+            case DSPUtils::GrainWindow::Shape::BlackmanHarris:
+                windowText += "BH";
+                break;
+            case DSPUtils::GrainWindow::Shape::NumShapes:
+                break;
+        }
+        windowButton->setButtonText(windowText);
+    }
+}
+
 void SondyQ2AudioProcessorEditor::updatePlayheadPosition(double position)
 {
     if (waveformDisplay != nullptr)
@@ -41,6 +41,9 @@ private:
     std::unique_ptr<juce::TextButton> holdButton;
     std::unique_ptr<juce::TextButton> stopButton;
     std::unique_ptr<juce::TextButton> modeButton;
+    std::unique_ptr<juce::TextButton> windowButton;
+    std::unique_ptr<juce::TextButton> liveButton;
+    std::unique_ptr<juce::TextButton> freezeButton;
     std::unique_ptr<juce::Slider> speedSlider;
     std::unique_ptr<juce::Slider> grainSizeSlider;
     CustomLookAndFeel customLookAndFeel;
@@ -60,6 +63,8 @@ private:
     void updateLoopButtonText();
     void updateHoldButtonText();
     void updateModeButtonText();
+    void updateWindowButtonText();
+    void updateLiveButtonText();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SondyQ2AudioProcessorEditor)
 };
\ No newline at end of file
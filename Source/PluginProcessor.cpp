@@ -1,5 +1,7 @@
 #include "PluginProcessor.h"
-#include "PluginEditor.h"
+#if ! SPECULATOR_HEADLESS
+ #include "PluginEditor.h"
+#endif
 
 SondyQ2AudioProcessor::SondyQ2AudioProcessor()
     : AudioProcessor (BusesProperties()
@@ -7,15 +9,26 @@ SondyQ2AudioProcessor::SondyQ2AudioProcessor()
                      .withOutput ("Output", juce::AudioChannelSet::stereo(), true))
 {
     samplePlayer = std::make_unique<SamplePlayer>();
+    
+    // SPECULATOR_HUGE_PAGES=1 backs the real-time state with huge pages where the OS allows
+    samplePlayer->setUseHugePages(juce::SystemStats::getEnvironmentVariable("SPECULATOR_HUGE_PAGES", {}).getIntValue() != 0);
+    
+    // SPECULATOR_SPECTRAL_INDEX=1 analyses each loaded sample for cheap phase vocoder freezes
+    samplePlayer->setSpectralIndexEnabled(juce::SystemStats::getEnvironmentVariable("SPECULATOR_SPECTRAL_INDEX", {}).getIntValue() != 0);
 }
 
 SondyQ2AudioProcessor::~SondyQ2AudioProcessor()
 {
+    cancelPendingUpdate();
 }
 
 const juce::String SondyQ2AudioProcessor::getName() const
 {
+   #ifdef JucePlugin_Name
     return JucePlugin_Name;
+   #else
+    return "Speculator";
+   #endif
 }
 
 bool SondyQ2AudioProcessor::acceptsMidi() const
@@ -63,7 +76,17 @@ void SondyQ2AudioProcessor::changeProgramName (int index, const juce::String& ne
 
 void SondyQ2AudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+    preparedSampleRate = sampleRate;
+    preparedBlockSize = samplesPerBlock;
+    sessionNeedsHeader = true;
+    
+    // Pick the widest SIMD kernels this CPU runs (SPECULATOR_ISA overrides)
+    samplePlayer->setKernelISA(DSPKernels::getPreferredISA());
+    
     samplePlayer->prepareToPlay(sampleRate, samplesPerBlock);
+    cpuGovernor.prepare(sampleRate);
+    applyRenderMode(isNonRealtime());
+    setLatencySamples(samplePlayer->getLatencySamples());
 }
 
 void SondyQ2AudioProcessor::releaseResources()
@@ -89,32 +112,69 @@ void SondyQ2AudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
+    const auto blockStart = juce::Time::getHighResolutionTicks();
+    
+    // Hosts may flip to offline rendering without preparing again. The
+    // latency this changes is reported from the message thread.
+    if (isNonRealtime() != renderingOffline)
+    {
+        applyRenderMode(isNonRealtime());
+        pendingLatency = samplePlayer->getLatencySamples();
+        triggerAsyncUpdate();
+    }
+    
     // Clear any output channels that don't have input data
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    // Process MIDI messages and pass to SamplePlayer
-    for (const auto metadata : midiMessages)
-    {
-        const auto message = metadata.getMessage();
-        samplePlayer->handleMidiMessage(message);
-    }
-    
-    // Process audio through SamplePlayer
-    samplePlayer->processBlock(buffer, 0, buffer.getNumSamples());
+    if (sessionRecorder.isRecording())
+        recordSessionBlock(buffer, midiMessages);
+
+    // The input is captured for live granulation before the player overwrites it
+    samplePlayer->captureInput(buffer, totalNumInputChannels);
+
+    // Render the block in spans split at note events, so notes start on
+    // their own sample. Other events only set parameters, so they're applied
+    // at the start of the span they fall in rather than splitting it, and a
+    // controller stream costs nothing extra. A span opened by a note runs at
+    // least MIN_SUB_BLOCK_SIZE samples: notes inside it are applied at its
+    // start, up to MIN_SUB_BLOCK_SIZE - 1 samples early, which bounds a block
+    // to numSamples / MIN_SUB_BLOCK_SIZE + 2 spans however dense the notes.
+    // A note alone keeps its exact sample. SamplePlayer renders every output
+    // channel itself.
+    const int numSamples = buffer.getNumSamples();
+    auto event = midiMessages.begin();
+    const auto endOfEvents = midiMessages.end();
+    int position = 0;
     
-    // Make sure all output channels are populated (in case SamplePlayer only filled the first channel)
-    for (int channel = 1; channel < totalNumOutputChannels; ++channel)
+    while (position < numSamples)
     {
-        const float* channelData = buffer.getReadPointer(0);
-        float* outputData = buffer.getWritePointer(channel);
+        const int earliestSplit = position == 0 ? 1 : position + MIN_SUB_BLOCK_SIZE;
+        int spanEnd = numSamples;
         
-        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
+        for (; event != endOfEvents && (*event).samplePosition < numSamples; ++event)
         {
-            outputData[sample] = channelData[sample];
+            const auto message = (*event).getMessage();
+            if ((*event).samplePosition >= earliestSplit && SamplePlayer::changesVoices(message))
+            {
+                spanEnd = (*event).samplePosition;
+                break;
+            }
+            
+            samplePlayer->handleMidiMessage(message);
         }
+        
+        samplePlayer->processBlock(buffer, position, spanEnd - position);
+        position = spanEnd;
     }
     
+    // Events stamped past the end of the block still take effect
+    for (; event != endOfEvents; ++event)
+        samplePlayer->handleMidiMessage((*event).getMessage());
+    
+    updateRenderQuality(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - blockStart), numSamples);
+    
+   #if ! SPECULATOR_HEADLESS
     // Update UI from audio thread
     auto* editor = dynamic_cast<SondyQ2AudioProcessorEditor*>(getActiveEditor());
     if (editor != nullptr)
@@ -122,16 +182,25 @@ void SondyQ2AudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce
         editor->updateCurrentLevel(samplePlayer->getCurrentLevel());
         editor->updatePlayheadPosition(samplePlayer->getCurrentPosition());
     }
+   #endif
 }
 
 bool SondyQ2AudioProcessor::hasEditor() const
 {
+   #if SPECULATOR_HEADLESS
+    return false;
+   #else
     return true;
+   #endif
 }
 
 juce::AudioProcessorEditor* SondyQ2AudioProcessor::createEditor()
 {
+   #if SPECULATOR_HEADLESS
+    return nullptr;
+   #else
     return new SondyQ2AudioProcessorEditor (*this);
+   #endif
 }
 
 void SondyQ2AudioProcessor::getStateInformation (juce::MemoryBlock& destData)
@@ -148,6 +217,8 @@ void SondyQ2AudioProcessor::loadSample(const juce::File& file)
         return;
         
     samplePlayer->loadFile(file);
+    currentSampleFile = file;
+    sessionRecorder.recordSample(file.getFullPathName());
 }
 
 void SondyQ2AudioProcessor::setPlaybackSpeed(float speed)
@@ -205,12 +276,196 @@ void SondyQ2AudioProcessor::setGrainSize(float sizeInSeconds)
         samplePlayer->setGrainDuration(sizeInSeconds);
 }
 
+void SondyQ2AudioProcessor::setOversamplingFactor(int factor)
+{
+    if (!samplePlayer)
+        return;
+    
+    samplePlayer->setOversamplingFactor(factor);
+    
+    // The clippers pick the new factor up on the next block
+    setLatencySamples(samplePlayer->getLatencySamples());
+}
+
+void SondyQ2AudioProcessor::applyRenderMode(bool offline)
+{
+    // Offline there is no deadline, so the governor stands down and the
+    // player gets its most expensive configuration. The oversampling floor
+    // changes the latency, which the caller reports to the host.
+    renderingOffline = offline;
+    cpuGovernor.reset();
+    qualityLevel = 0;
+    
+    samplePlayer->setRenderQuality(offline ? SamplePlayer::getNonRealtimeQuality() : CpuGovernor::getQualityForLevel(0));
+}
+
+void SondyQ2AudioProcessor::handleAsyncUpdate()
+{
+    setLatencySamples(pendingLatency);
+}
+
+void SondyQ2AudioProcessor::updateRenderQuality(double blockSeconds, int numSamples)
+{
+    if (renderingOffline)
+        return;
+    
+    // The new quality applies from the next block
+    if (!adaptiveQuality)
+    {
+        if (cpuGovernor.getLevel() != 0)
+        {
+            cpuGovernor.reset();
+            samplePlayer->setRenderQuality(CpuGovernor::getQualityForLevel(0));
+            qualityLevel = 0;
+        }
+        return;
+    }
+    
+    if (cpuGovernor.update(blockSeconds, numSamples))
+    {
+        samplePlayer->setRenderQuality(CpuGovernor::getQualityForLevel(cpuGovernor.getLevel()));
+        qualityLevel = cpuGovernor.getLevel();
+    }
+}
+
+void SondyQ2AudioProcessor::applyParameter(SessionLog::ParameterId parameter, float value)
+{
+    using SessionLog::ParameterId;
+    using Descriptor = SamplePlayer::Descriptor;
+    
+    switch (parameter)
+    {
+        case ParameterId::PlaybackSpeed:      setPlaybackSpeed(value); break;
+        case ParameterId::Looping:            setLooping(value > 0.5f); break;
+        case ParameterId::HoldMode:           setHoldMode(value > 0.5f); break;
+        case ParameterId::HoldPosition:       samplePlayer->setHoldPosition(value); break;
+        case ParameterId::GrainDuration:      setGrainSize(value); break;
+        case ParameterId::PlaybackMode:
+            setPlaybackMode(static_cast<SamplePlayer::PlaybackMode>(juce::roundToInt(value)));
+            break;
+        case ParameterId::WindowShape:
+            samplePlayer->setWindowShape(static_cast<DSPUtils::GrainWindow::Shape>(juce::roundToInt(value)));
+            break;
+        case ParameterId::OversamplingFactor: setOversamplingFactor(juce::roundToInt(value)); break;
+        case ParameterId::Pan:                samplePlayer->setPan(value); break;
+        case ParameterId::Spread:             samplePlayer->setSpread(value); break;
+        case ParameterId::SynthesisMode:
+            samplePlayer->setSynthesisMode(static_cast<SamplePlayer::SynthesisMode>(juce::roundToInt(value)));
+            setLatencySamples(samplePlayer->getLatencySamples());
+            break;
+        case ParameterId::CloudDensity:       samplePlayer->setCloudDensity(value); break;
+        case ParameterId::PositionJitter:     samplePlayer->setPositionJitter(value); break;
+        case ParameterId::PitchJitter:        samplePlayer->setPitchJitter(value); break;
+        case ParameterId::DurationJitter:     samplePlayer->setDurationJitter(value); break;
+        case ParameterId::GrainSnap:
+            samplePlayer->setGrainSnap(static_cast<SamplePlayer::GrainSnap>(juce::roundToInt(value)));
+            break;
+        case ParameterId::SnapRange:          samplePlayer->setSnapRange(value); break;
+        case ParameterId::SnapStrength:       samplePlayer->setSnapStrength(value); break;
+        case ParameterId::TargetLoudness:     samplePlayer->setDescriptorTarget(Descriptor::Loudness, value); break;
+        case ParameterId::TargetBrightness:   samplePlayer->setDescriptorTarget(Descriptor::Brightness, value); break;
+        case ParameterId::TargetNoisiness:    samplePlayer->setDescriptorTarget(Descriptor::Noisiness, value); break;
+        case ParameterId::TargetZeroCrossingRate: samplePlayer->setDescriptorTarget(Descriptor::ZeroCrossingRate, value); break;
+        case ParameterId::LoudnessWeight:     samplePlayer->setDescriptorWeight(Descriptor::Loudness, value); break;
+        case ParameterId::BrightnessWeight:   samplePlayer->setDescriptorWeight(Descriptor::Brightness, value); break;
+        case ParameterId::NoisinessWeight:    samplePlayer->setDescriptorWeight(Descriptor::Noisiness, value); break;
+        case ParameterId::PitchWeight:        samplePlayer->setDescriptorWeight(Descriptor::Pitch, value); break;
+        case ParameterId::ZeroCrossingRateWeight: samplePlayer->setDescriptorWeight(Descriptor::ZeroCrossingRate, value); break;
+        case ParameterId::NumParameters:      break;
+    }
+}
+
+void SondyQ2AudioProcessor::cycleWindowShape()
+{
+    if (!samplePlayer)
+        return;
+    
+    using Shape = DSPUtils::GrainWindow::Shape;
+    const int next = (static_cast<int>(samplePlayer->getWindowShape()) + 1) % static_cast<int>(Shape::NumShapes);
+    samplePlayer->setWindowShape(static_cast<Shape>(next));
+}
+
 float SondyQ2AudioProcessor::getGrainSize() const
 {
     return samplePlayer ? samplePlayer->getGrainDuration() : 0.1f;
 }
 
+bool SondyQ2AudioProcessor::startSessionRecording(const juce::File& logFile)
+{
+    sessionNeedsHeader = true;
+    return sessionRecorder.start(logFile, currentSampleFile.getFullPathName());
+}
+
+void SondyQ2AudioProcessor::stopSessionRecording()
+{
+    sessionRecorder.stop();
+}
+
+void SondyQ2AudioProcessor::recordSessionBlock(const juce::AudioBuffer<float>& buffer, const juce::MidiBuffer& midiMessages)
+{
+    using SessionLog::ParameterId;
+    using Descriptor = SamplePlayer::Descriptor;
+    
+    // Parameters are snapshotted here rather than in the setters so that the
+    // audio thread stays the only writer to the recorder's ring
+    const std::array<float, static_cast<size_t>(ParameterId::NumParameters)> parameters {
+        samplePlayer->getPlaybackSpeed(),
+        samplePlayer->getLooping() ? 1.0f : 0.0f,
+        samplePlayer->getHoldMode() ? 1.0f : 0.0f,
+        static_cast<float>(samplePlayer->getHoldPosition()),
+        samplePlayer->getGrainDuration(),
+        static_cast<float>(samplePlayer->getPlaybackMode()),
+        static_cast<float>(samplePlayer->getWindowShape()),
+        static_cast<float>(samplePlayer->getOversamplingFactor()),
+        samplePlayer->getPan(),
+        samplePlayer->getSpread(),
+        static_cast<float>(samplePlayer->getSynthesisMode()),
+        samplePlayer->getCloudDensity(),
+        samplePlayer->getPositionJitter(),
+        samplePlayer->getPitchJitter(),
+        samplePlayer->getDurationJitter(),
+        static_cast<float>(samplePlayer->getGrainSnap()),
+        samplePlayer->getSnapRange(),
+        samplePlayer->getSnapStrength(),
+        samplePlayer->getDescriptorTarget(Descriptor::Loudness),
+        samplePlayer->getDescriptorTarget(Descriptor::Brightness),
+        samplePlayer->getDescriptorTarget(Descriptor::Noisiness),
+        samplePlayer->getDescriptorTarget(Descriptor::ZeroCrossingRate),
+        samplePlayer->getDescriptorWeight(Descriptor::Loudness),
+        samplePlayer->getDescriptorWeight(Descriptor::Brightness),
+        samplePlayer->getDescriptorWeight(Descriptor::Noisiness),
+        samplePlayer->getDescriptorWeight(Descriptor::Pitch),
+        samplePlayer->getDescriptorWeight(Descriptor::ZeroCrossingRate)
+    };
+    
+    if (sessionNeedsHeader)
+        sessionRecorder.recordPrepare(preparedSampleRate, preparedBlockSize);
+    
+    for (size_t i = 0; i < parameters.size(); ++i)
+    {
+        if (sessionNeedsHeader || parameters[i] != lastRecordedParameters[i])
+            sessionRecorder.recordParameter(static_cast<ParameterId>(i), parameters[i]);
+    }
+    
+    lastRecordedParameters = parameters;
+    sessionNeedsHeader = false;
+    
+    for (const auto metadata : midiMessages)
+        sessionRecorder.recordMidi(metadata.samplePosition, metadata.data, metadata.numBytes);
+    
+    sessionRecorder.recordBlock(buffer.getNumSamples());
+}
+
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 {
-    return new SondyQ2AudioProcessor();
+    auto* processor = new SondyQ2AudioProcessor();
+    
+    // Set SPECULATOR_SESSION_LOG to capture the session for speculator-replay.
+    // Only the plugin wrapper starts it, so the tools' processors (several at
+    // once in a batch render) never share the log file.
+    auto sessionLogPath = juce::SystemStats::getEnvironmentVariable("SPECULATOR_SESSION_LOG", {});
+    if (sessionLogPath.isNotEmpty())
+        processor->startSessionRecording(juce::File(sessionLogPath));
+    
+    return processor;
 }
\ No newline at end of file
@@ -11,9 +11,12 @@
 #include <juce_graphics/juce_graphics.h>
 #include <juce_gui_basics/juce_gui_basics.h>
 #include <juce_gui_extra/juce_gui_extra.h>
+#include "CpuGovernor.h"
 #include "SamplePlayer.h"
+#include "SessionRecorder.h"
 
-class SondyQ2AudioProcessor : public juce::AudioProcessor
+class SondyQ2AudioProcessor : public juce::AudioProcessor,
+                              private juce::AsyncUpdater
 {
 public:
     SondyQ2AudioProcessor();
@@ -51,16 +54,52 @@ public:
     void setHoldMode(bool shouldHold);
     void setGrainSize(float sizeInSeconds);
     float getGrainSize() const;
+    void cycleWindowShape();  // Cycles through the grain window shapes
+    void setOversamplingFactor(int factor);  // Soft clipper oversampling: 1, 2 or 4
 
     SamplePlayer* getSamplePlayer() { return samplePlayer.get(); }
+    
+    // Sets any parameter by its session log id, as replayed sessions and render presets do
+    void applyParameter(SessionLog::ParameterId parameter, float value);
 
     // New methods for playback mode
     void setPlaybackMode(SamplePlayer::PlaybackMode mode);
     SamplePlayer::PlaybackMode getPlaybackMode() const;
     void cyclePlaybackMode();  // Cycles through the available modes
 
+    // Lower render quality when blocks run close to their deadline (on by default)
+    void setAdaptiveQuality(bool shouldAdapt) { adaptiveQuality = shouldAdapt; }
+    bool getAdaptiveQuality() const { return adaptiveQuality; }
+    int getQualityLevel() const { return qualityLevel; }  // 0 is full quality
+
+    // Session capture for reproducing performance problems offline
+    bool startSessionRecording(const juce::File& logFile);
+    void stopSessionRecording();
+    bool isRecordingSession() const { return sessionRecorder.isRecording(); }
+
 private:
+    static constexpr int MIN_SUB_BLOCK_SIZE = 32;  // Shortest span a note event opens
+    
     std::unique_ptr<SamplePlayer> samplePlayer;
+    
+    CpuGovernor cpuGovernor;
+    std::atomic<bool> adaptiveQuality{ true };
+    std::atomic<int> qualityLevel{ 0 };
+    bool renderingOffline = false;
+    std::atomic<int> pendingLatency{ 0 };  // Posted from the audio thread to the message thread
+    
+    // Session recording
+    SessionRecorder sessionRecorder;
+    juce::File currentSampleFile;
+    double preparedSampleRate = 44100.0;
+    int preparedBlockSize = 512;
+    bool sessionNeedsHeader = true;
+    std::array<float, static_cast<size_t>(SessionLog::ParameterId::NumParameters)> lastRecordedParameters{};
+    
+    void applyRenderMode(bool offline);
+    void handleAsyncUpdate() override;
+    void updateRenderQuality(double blockSeconds, int numSamples);
+    void recordSessionBlock(const juce::AudioBuffer<float>& buffer, const juce::MidiBuffer& midiMessages);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SondyQ2AudioProcessor)
 };
\ No newline at end of file
@@ -54,36 +54,113 @@ void SamplePlayer::loadFile(const juce::File& file)
     
     if (reader != nullptr)
     {
+        spectralIndex.cancel();  // All read fileBuffer
+        onsetIndex.cancel();
+        pitchMarks.cancel();
+        descriptorIndex.cancel();
         fileBuffer.setSize(reader->numChannels, reader->lengthInSamples);
         reader->read(&fileBuffer, 0, reader->lengthInSamples, 0, true, true);
         
         fileSampleRate = reader->sampleRate;
         sampleRateRatio = currentSampleRate / fileSampleRate;
         
-        // Normalize and apply DC blocking
-        float maxSample = 0.0f;
-        DSPUtils::DCBlocker dcBlocker;
+        normaliseSample();
+        ++sourceVersion;
+        ++sampleVersion;
         
-        for (int channel = 0; channel < fileBuffer.getNumChannels(); ++channel)
-        {
-            float* channelData = fileBuffer.getWritePointer(channel);
-            
-            // First pass: find max sample and apply DC blocking
-            for (int i = 0; i < fileBuffer.getNumSamples(); ++i)
-            {
-                channelData[i] = dcBlocker.process(channelData[i]);
-                maxSample = std::max(maxSample, std::abs(channelData[i]));
-            }
-        }
+        // Each index builds on its own thread, alongside the others
+        onsetIndex.build(fileBuffer, fileSampleRate, sampleVersion);
+        if (spectralIndexEnabled)
+            spectralIndex.build(fileBuffer, fileSampleRate, sampleVersion);
+        buildSynthesisModeIndex();
+    }
+}
+
+void SamplePlayer::loadBuffer(const juce::AudioBuffer<float>& source, double sourceSampleRate)
+{
+    reader.reset();
+    spectralIndex.cancel();
+    onsetIndex.cancel();
+    pitchMarks.cancel();
+    descriptorIndex.cancel();
+    fileBuffer.makeCopyOf(source);
+    
+    fileSampleRate = sourceSampleRate;
+    sampleRateRatio = currentSampleRate / fileSampleRate;
+    
+    normaliseSample();
+    ++sourceVersion;
+    ++sampleVersion;
+    onsetIndex.build(fileBuffer, fileSampleRate, sampleVersion);
+    if (spectralIndexEnabled)
+        spectralIndex.build(fileBuffer, fileSampleRate, sampleVersion);
+    buildSynthesisModeIndex();
+}
+
+void SamplePlayer::setSynthesisMode(SynthesisMode mode)
+{
+    synthesisMode = mode;
+    buildSynthesisModeIndex();
+}
+
+void SamplePlayer::buildSynthesisModeIndex()
+{
+    if (!isFileLoaded())
+        return;
+    
+    if (synthesisMode == SynthesisMode::Psola && !pitchMarks.isBuildingOrBuilt(sampleVersion))
+        pitchMarks.build(fileBuffer, fileSampleRate, sampleVersion);
+    else if (synthesisMode == SynthesisMode::Concatenative && !descriptorIndex.isBuildingOrBuilt(sampleVersion))
+        descriptorIndex.build(fileBuffer, fileSampleRate, sampleVersion);
+}
+
+bool SamplePlayer::waitForIndexes(int timeoutMs)
+{
+    // Every one is waited for, even after one times out
+    bool built = spectralIndex.waitUntilBuilt(timeoutMs);
+    built = onsetIndex.waitUntilBuilt(timeoutMs) && built;
+    built = pitchMarks.waitUntilBuilt(timeoutMs) && built;
+    built = descriptorIndex.waitUntilBuilt(timeoutMs) && built;
+    return built;
+}
+
+void SamplePlayer::setSpectralIndexEnabled(bool shouldBuild)
+{
+    if (shouldBuild == spectralIndexEnabled)
+        return;
+    
+    spectralIndexEnabled = shouldBuild;
+    if (!shouldBuild)
+        spectralIndex.cancel();
+    else if (isFileLoaded())
+        spectralIndex.build(fileBuffer, fileSampleRate, sampleVersion);
+}
+
+void SamplePlayer::normaliseSample()
+{
+    // Normalize and apply DC blocking
+    float maxSample = 0.0f;
+    
+    for (int channel = 0; channel < fileBuffer.getNumChannels(); ++channel)
+    {
+        float* channelData = fileBuffer.getWritePointer(channel);
+        DSPUtils::DCBlocker dcBlocker;  // Fresh per channel so state doesn't carry across
         
-        if (maxSample > 0.0f)
+        // First pass: find max sample and apply DC blocking
+        for (int i = 0; i < fileBuffer.getNumSamples(); ++i)
         {
-            float scale = 0.95f / maxSample;
-            fileBuffer.applyGain(scale);
+            channelData[i] = dcBlocker.process(channelData[i]);
+            maxSample = std::max(maxSample, std::abs(channelData[i]));
         }
-        
-        applyFades();
     }
+    
+    if (maxSample > 0.0f)
+    {
+        float scale = 0.95f / maxSample;
+        fileBuffer.applyGain(scale);
+    }
+    
+    applyFades();
 }
 
 void SamplePlayer::applyFades()
@@ -115,20 +192,80 @@ void SamplePlayer::prepareToPlay(double sampleRate, int samplesPerBlock)
     currentSampleRate = sampleRate;
     sampleRateRatio = currentSampleRate / fileSampleRate;
     
-    tempBuffer.setSize(2, samplesPerBlock);
+    // Run the layout once to size the arena, then again to carve it
+    arena.beginMeasure();
+    layoutRealtimeState(sampleRate, samplesPerBlock);
+    arena.commit(useHugePages);
+    layoutRealtimeState(sampleRate, samplesPerBlock);
     
-    // Initialize all DSP components
-    outputLimiter.prepare(sampleRate);
+    // All voices share the same overlap, so one table per shape covers them
+    for (size_t shape = 0; shape < windowTables.size(); ++shape)
+        windowTables[shape].build(static_cast<DSPUtils::GrainWindow::Shape>(shape), voices.front().grainOverlap);
     
     for (auto& voice : voices)
     {
-        voice.prepare(sampleRate);
+        for (auto& chain : voice.chains)
+            chain.softClipper.setOversamplingFactor(oversamplingFactor);
         voice.envelope.setParameters(0.01f, 0.1f, 0.7f, 0.2f, static_cast<float>(sampleRate));
     }
 }
 
+void SamplePlayer::setKernelISA(DSPKernels::ISA isa)
+{
+    kernels = &DSPKernels::getTable(isa);
+    grainCloud.setKernels(*kernels);
+    outputLimiter.setKernels(*kernels);
+    
+    for (auto& voice : voices)
+    {
+        for (auto& chain : voice.chains)
+            chain.softClipper.setKernels(*kernels);
+    }
+}
+
+void SamplePlayer::layoutRealtimeState(double sampleRate, int samplesPerBlock)
+{
+    // Hottest first: the scratch buffers every voice touches each block
+    auto carveBuffer = [this, samplesPerBlock](juce::AudioBuffer<float>& buffer, int numChannels)
+    {
+        std::array<float*, MAX_OUTPUT_CHANNELS> channels{};
+        for (int channel = 0; channel < numChannels; ++channel)
+            channels[static_cast<size_t>(channel)] = arena.allocate<float>(static_cast<size_t>(samplesPerBlock));
+        buffer.setDataToReferTo(channels.data(), numChannels, samplesPerBlock);
+    };
+    
+    carveBuffer(tempBuffer, MAX_OUTPUT_CHANNELS);
+    
+    numVoiceScratchSets = voiceThreadPool != nullptr ? MAX_VOICES : 1;
+    for (int set = 0; set < numVoiceScratchSets; ++set)
+    {
+        auto& scratch = voiceScratch[static_cast<size_t>(set)];
+        for (auto& channel : scratch.channels)
+            channel.allocate(static_cast<size_t>(samplesPerBlock), &arena);
+        scratch.gains.allocate(static_cast<size_t>(samplesPerBlock), &arena);
+        scratch.vocoder.allocate(arena);
+    }
+    
+    // Then each voice's grains and channel chains, contiguous per voice
+    for (auto& voice : voices)
+        voice.prepare(sampleRate, samplesPerBlock, arena);
+    
+    // The cloud pool, only touched in cloud mode
+    grainCloud.prepare(arena);
+    cloudJitter.allocate(static_cast<size_t>(GrainCloud::MAX_GRAINS) * 4, &arena);
+    
+    outputLimiter.prepare(sampleRate, samplesPerBlock, MAX_OUTPUT_CHANNELS, &arena);
+    
+    // Coldest and largest last: the capture only sees each block twice
+    liveCapture.prepare(sampleRate, arena);
+}
+
 void SamplePlayer::releaseResources()
 {
+    spectralIndex.cancel();
+    onsetIndex.cancel();
+    pitchMarks.cancel();
+    descriptorIndex.cancel();
     reader.reset();
     fileBuffer.clear();
     for (auto& voice : voices)
@@ -137,103 +274,767 @@ void SamplePlayer::releaseResources()
         voice.grains.clear();
         voice.lastOutputSample = 0.0f;
     }
+    grainCloud.clear();
+}
+
+void SamplePlayer::captureInput(const juce::AudioBuffer<float>& input, int numInputChannels)
+{
+    const int numSamples = input.getNumSamples();
+    const bool frozen = liveFrozen.load();
+    
+    // A frozen window holds still, so it plays exactly like a loaded sample
+    if (!frozen)
+        liveCapture.write(input.getArrayOfReadPointers(), std::min(numInputChannels, input.getNumChannels()), numSamples);
+    
+    const bool live = liveInput.load();
+    const int windowLength = live ? std::min(liveCapture.getCapacity(), juce::roundToInt(liveHorizon.load() * currentSampleRate)) : 0;
+    
+    if (live != liveInputActive)
+    {
+        const int previousLength = getSourceLength();
+        liveInputActive = live;
+        liveWindowLength = windowLength;
+        restartVoicesOnNewSource(previousLength);
+        return;
+    }
+    
+    const int advance = frozen ? 0 : numSamples;
+    if (!live || (windowLength == liveWindowLength && advance == 0))
+        return;
+    
+    // Window positions count from the oldest sample the horizon reaches, so
+    // captured audio moves towards zero as new input arrives
+    const int previousLength = liveWindowLength;
+    liveWindowLength = windowLength;
+    shiftLivePositions(windowLength - previousLength - advance,
+                       previousLength > 0 ? static_cast<double>(windowLength) / previousLength : 1.0);
+    ++sourceVersion;
+}
+
+void SamplePlayer::restartVoicesOnNewSource(int previousLength)
+{
+    // Nothing the grains were reading exists in the other source. The hold
+    // position keeps its place as a fraction of the source.
+    const int length = getSourceLength();
+    holdPosition = previousLength > 0 ? holdPosition * length / previousLength : 0.0;
+    
+    for (auto& voice : voices)
+    {
+        voice.grains.clear();
+        voice.grainCache.invalidate();
+        voice.position = isHoldMode ? holdPosition : 0.0;
+    }
+    
+    grainCloud.clear();
+    ++sourceVersion;
+}
+
+void SamplePlayer::shiftLivePositions(double grainShift, double holdScale)
+{
+    // Grains keep reading the audio they started on. Held voices stay the same
+    // fraction of the horizon behind now; free-running ones move with their
+    // audio and, once it falls out of the window, loop back to now or stay at
+    // the oldest sample.
+    holdPosition *= holdScale;
+    grainCloud.shiftPositions(juce::roundToInt(grainShift));
+    
+    for (auto& voice : voices)
+    {
+        for (auto& grain : voice.grains)
+        {
+            grain.startPosition += grainShift;
+            grain.currentPosition += grainShift;
+        }
+        
+        if (isHoldMode)
+        {
+            voice.position = holdPosition;
+        }
+        else
+        {
+            voice.position += grainShift;
+            if (voice.position < 0.0)
+                voice.position = std::max(0.0, isLooping ? voice.position + liveWindowLength : 0.0);
+        }
+    }
 }
 
 void SamplePlayer::processBlock(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
 {
-    if (!fileBuffer.getNumSamples() || !isEnabled)
+    if (!hasSource() || !isEnabled)
         return;
         
     buffer.clear(startSample, numSamples);
-    tempBuffer.clear();
+    tempBuffer.clear(0, numSamples);
+    
+    // Neither mode's state means anything to the other, so voices pick up afresh
+    if (synthesisMode != renderedSynthesisMode)
+    {
+        renderedSynthesisMode = synthesisMode;
+        for (auto& voice : voices)
+        {
+            voice.grains.clear();
+            voice.grainCache.invalidate();
+            voice.phaseVocoder.reset();
+        }
+        grainCloud.clear();
+    }
+    
+    // Finished indexes are taken up here, so every voice reads the same ones
+    spectralIndex.update(false);  // Offline renders analyse instead
+    onsetIndex.update(renderQuality.highPrecision);
+    pitchMarks.update(renderQuality.highPrecision);
+    descriptorIndex.update(renderQuality.highPrecision);
     
     float maxLevel = 0.0f;
     
-    // Process each voice
+    // Mono sources are read once per grain and panned; stereo sources keep
+    // their channels. Live input is read where the capture left it.
+    RenderContext context;
+    context.window = &windowTables[static_cast<size_t>(windowShape)];
+    context.sourceVersion = sourceVersion;
+    if (liveInputActive)
+    {
+        context.numSourceChannels = LiveCapture::NUM_CHANNELS;
+        context.sourceLength = liveWindowLength;
+        for (int channel = 0; channel < MAX_OUTPUT_CHANNELS; ++channel)
+            context.sourceChannels[channel] = liveCapture.getRecent(channel, liveWindowLength);
+    }
+    else
+    {
+        context.numSourceChannels = std::min(fileBuffer.getNumChannels(), MAX_OUTPUT_CHANNELS);
+        context.sourceLength = fileBuffer.getNumSamples();
+        for (int channel = 0; channel < MAX_OUTPUT_CHANNELS; ++channel)
+            context.sourceChannels[channel] = fileBuffer.getReadPointer(std::min(channel, context.numSourceChannels - 1));
+    }
+    
+    if (usesGrainPool(renderedSynthesisMode))
+        schedulePooledGrains(context, numSamples);
+    
+    std::array<Voice*, MAX_VOICES> activeVoices{};
+    int numActive = 0;
     for (auto& voice : voices)
     {
-        if (!voice.isActive)
-            continue;
-            
-        for (int sample = 0; sample < numSamples; ++sample)
+        if (voice.isActive)
+            activeVoices[static_cast<size_t>(numActive++)] = &voice;
+    }
+    
+    if (voiceThreadPool != nullptr && numVoiceScratchSets == MAX_VOICES && numActive > 1)
+    {
+        maxLevel = renderVoicesInParallel(activeVoices.data(), numActive, context, numSamples);
+    }
+    else
+    {
+        for (int channel = 0; channel < MAX_OUTPUT_CHANNELS; ++channel)
+            context.mix[channel] = tempBuffer.getWritePointer(channel);
+        
+        for (int i = 0; i < numActive; ++i)
+            maxLevel = std::max(maxLevel, renderVoiceWithKernel(*activeVoices[static_cast<size_t>(i)], voiceScratch.front(), context, numSamples));
+    }
+    
+    // Voices whose release has finished can be reused. Their pooled grains
+    // are silent under the closed envelope, so they go now rather than
+    // playing on into whatever note takes the voice next.
+    for (int i = 0; i < numActive; ++i)
+    {
+        auto* voice = activeVoices[static_cast<size_t>(i)];
+        if (voice->envelope.isIdle())
+        {
+            voice->reset();
+            if (usesGrainPool(renderedSynthesisMode))
+                grainCloud.releaseVoice(static_cast<int>(voice - voices.data()));
+        }
+    }
+    
+    // Final output processing, with one gain shared by all channels
+    const int numOutputChannels = std::min(buffer.getNumChannels(), MAX_OUTPUT_CHANNELS);
+    std::array<float*, MAX_OUTPUT_CHANNELS> outputChannels{};
+    
+    // A mono output gets the average of the rendered channels
+    if (numOutputChannels == 1)
+    {
+        for (int channel = 1; channel < MAX_OUTPUT_CHANNELS; ++channel)
+            tempBuffer.addFrom(0, 0, tempBuffer, channel, 0, numSamples);
+        tempBuffer.applyGain(0, 0, numSamples, 1.0f / MAX_OUTPUT_CHANNELS);
+    }
+    
+    for (int channel = 0; channel < numOutputChannels; ++channel)
+    {
+        outputChannels[channel] = buffer.getWritePointer(channel, startSample);
+        juce::FloatVectorOperations::copy(outputChannels[channel], tempBuffer.getReadPointer(channel), numSamples);
+    }
+    
+    outputLimiter.process(outputChannels.data(), numOutputChannels, numSamples);
+    
+    // The peak over all of a host block's spans, the first starting afresh
+    currentLevel.store(startSample == 0 ? maxLevel : std::max(maxLevel, currentLevel.load()));
+}
+
+template <size_t... Flags>
+constexpr std::array<SamplePlayer::RenderKernel, sizeof...(Flags)> SamplePlayer::makeRenderKernels(std::index_sequence<Flags...>)
+{
+    return {{ &SamplePlayer::renderVoice<(Flags & 16) != 0, (Flags & 8) != 0, (Flags & 4) != 0, (Flags & 2) != 0, (Flags & 1) != 0>... }};
+}
+
+SamplePlayer::RenderKernel SamplePlayer::selectRenderKernel(bool highPrecision, bool holdMode, bool looping, bool stereoSource, bool pitchUp)
+{
+    // One instantiation per flag combination, indexed by the flags as bits
+    static constexpr auto kernels = makeRenderKernels(std::make_index_sequence<32>());
+    
+    return kernels[(highPrecision ? 16 : 0) | (holdMode ? 8 : 0) | (looping ? 4 : 0) | (stereoSource ? 2 : 0) | (pitchUp ? 1 : 0)];
+}
+
+float SamplePlayer::renderVoiceWithKernel(Voice& voice, VoiceScratch& scratch, const RenderContext& context, int numSamples)
+{
+    if (renderedSynthesisMode == SynthesisMode::PhaseVocoder)
+        return renderPhaseVocoderVoice(voice, scratch, context, numSamples);
+    if (usesGrainPool(renderedSynthesisMode))
+        return renderPooledVoice(voice, scratch, context, numSamples);
+    
+    // Process the voice with the kernel specialised for its current flags
+    const auto kernel = selectRenderKernel(renderQuality.highPrecision, isHoldMode, isLooping,
+                                           context.numSourceChannels > 1, voice.pitchRatio > 1.0);
+    return (this->*kernel)(voice, scratch, context, numSamples);
+}
+
+float SamplePlayer::renderVoicesInParallel(Voice* const* activeVoices, int numActive, const RenderContext& context, int numSamples)
+{
+    // Threads claim voices from a shared counter and leave each one in its own
+    // scratch set; summing those in voice order afterwards gives exactly the
+    // mix the single-threaded path builds
+    std::array<float, MAX_VOICES> peaks{};
+    std::atomic<int> nextVoice{ 0 };
+    
+    const auto renderClaimedVoices = [&]
+    {
+        for (int i = nextVoice++; i < numActive; i = nextVoice++)
+            peaks[static_cast<size_t>(i)] = renderVoiceWithKernel(*activeVoices[i], voiceScratch[static_cast<size_t>(i)], context, numSamples);
+    };
+    
+    const int numHelpers = std::min(voiceThreadPool->getNumThreads(), numActive - 1);
+    std::atomic<int> helpersRunning{ numHelpers };
+    juce::WaitableEvent helpersFinished;
+    
+    for (int helper = 0; helper < numHelpers; ++helper)
+    {
+        voiceThreadPool->addJob([&]
         {
-            float sampleValue = 0.0f;
+            renderClaimedVoices();
+            if (--helpersRunning == 0)
+                helpersFinished.signal();
+        });
+    }
+    
+    renderClaimedVoices();
+    if (numHelpers > 0)
+        helpersFinished.wait();
+    
+    for (int channel = 0; channel < MAX_OUTPUT_CHANNELS; ++channel)
+    {
+        float* mix = tempBuffer.getWritePointer(channel);
+        for (int i = 0; i < numActive; ++i)
+            juce::FloatVectorOperations::add(mix, voiceScratch[static_cast<size_t>(i)].channels[channel].data(), numSamples);
+    }
+    
+    return *std::max_element(peaks.begin(), peaks.begin() + numActive);
+}
+
+template <bool HighPrecision, bool HoldMode, bool Looping, bool StereoSource, bool PitchUp>
+float SamplePlayer::renderVoice(Voice& voice, VoiceScratch& scratch, const RenderContext& context, int numSamples)
+{
+    using Sample = std::conditional_t<HighPrecision, double, float>;
+    
+    const auto& window = *context.window;
+    const double step = voice.pitchRatio * playbackSpeed;
+    
+    float* voiceData[MAX_OUTPUT_CHANNELS];
+    for (int channel = 0; channel < MAX_OUTPUT_CHANNELS; ++channel)
+        voiceData[channel] = scratch.channels[channel].data();
+    
+    // Grains that are already playing would no longer match what was cached
+    if constexpr (HoldMode && !HighPrecision)
+    {
+        const auto& cache = voice.grainCache;
+        if (cache.length > 0 && (cache.step != step || cache.window != context.window
+                                 || cache.interpolationPoints != voice.resampler.getNumPoints()
+                                 || cache.sourceVersion != context.sourceVersion))
+            voice.grainCache.invalidate();
+    }
+    
+    for (int sample = 0; sample < numSamples; ++sample)
+    {
+        // Every output channel is accumulated in the same pass over the grains
+        std::array<Sample, MAX_OUTPUT_CHANNELS> frame{};
+        bool grainFinished = false;
+        
+        for (auto& grain : voice.grains)
+        {
+            // Calculate window position and gain
+            grain.phase = static_cast<float>(grain.windowPhase) * (1.0f / 4294967296.0f);
+            constexpr int numGrainChannels = StereoSource ? MAX_OUTPUT_CHANNELS : 1;
+            std::array<Sample, numGrainChannels> grainSamples;
             
-            // Process grains
-            for (auto& grain : voice.grains)
+            // A repeat of the cached grain is one multiply-add per channel
+            const int age = static_cast<int>(grain.age);
+            const auto& cache = voice.grainCache;
+            if (HoldMode && !HighPrecision && grain.cacheRole == Grain::CacheRole::Replay
+                && grain.cacheGeneration == cache.generation && age < cache.numRendered)
             {
-                if (!grain.isActive)
-                    continue;
-                    
-                // Calculate window position and gain
-                grain.phase = static_cast<float>(grain.age / grain.grainLength);
-                float windowGain = DSPUtils::GrainWindow::getGainAt(grain.phase, voice.grainOverlap);
-                
-                // Get interpolated sample with improved resampling
-                float interpolatedSample = voice.resampler.resample(
-                    fileBuffer.getReadPointer(0),
-                    grain.currentPosition,
-                    fileBuffer.getNumSamples()
-                );
-                
-                // Apply phase alignment
-                float phaseAlignedSample = interpolatedSample * 
-                    std::cos(grain.initialPhase + grain.phaseIncrement * grain.age);
+                for (int channel = 0; channel < numGrainChannels; ++channel)
+                    grainSamples[channel] = cache.channels[channel].data()[age];
+            }
+            else
+            {
+                const float windowGain = window.getGainAt(grain.windowPhase);
                 
-                sampleValue += phaseAlignedSample * windowGain;
+                // Window and phase alignment apply to every channel alike
+                Sample grainGain;
+                if constexpr (HighPrecision)
+                    grainGain = windowGain * std::cos(grain.initialPhase + grain.phaseIncrement * grain.age);
+                else
+                    grainGain = windowGain * DSPUtils::FastMath::cos(static_cast<float>(grain.initialPhase)
+                                                                     + static_cast<float>(grain.phaseIncrement) * static_cast<float>(grain.age));
                 
-                // Update grain position and age
-                grain.currentPosition += voice.pitchRatio * playbackSpeed;
-                grain.age++;
+                for (int channel = 0; channel < numGrainChannels; ++channel)
+                    grainSamples[channel] = static_cast<Sample>(voice.resampler.resample(
+                        context.sourceChannels[channel], grain.currentPosition, context.sourceLength)) * grainGain;
                 
-                if (grain.age >= grain.grainLength)
-                    grain.isActive = false;
-            }
-            
-            // Apply voice processing chain
-            if (voice.pitchRatio > 1.0) {
-                float cutoff = std::min(20000.0f, static_cast<float>(20000.0 / voice.pitchRatio));
-                voice.antiAliasFilter.setCutoff(cutoff);
-                sampleValue = voice.antiAliasFilter.process(sampleValue);
+                if constexpr (HoldMode && !HighPrecision)
+                {
+                    if (grain.cacheRole == Grain::CacheRole::Record && grain.cacheGeneration == cache.generation
+                        && age == cache.numRendered)
+                    {
+                        for (int channel = 0; channel < numGrainChannels; ++channel)
+                            voice.grainCache.channels[channel].data()[age] = grainSamples[channel];
+                        ++voice.grainCache.numRendered;
+                    }
+                }
             }
             
-            sampleValue = voice.dcBlocker.process(sampleValue);
-            sampleValue = voice.softClipper.process(sampleValue);
+            for (int channel = 0; channel < MAX_OUTPUT_CHANNELS; ++channel)
+                frame[channel] += grainSamples[StereoSource ? channel : 0] * grain.panGains[channel];
             
-            // Apply envelope
-            float envelopeGain = voice.envelope.process();
-            sampleValue *= envelopeGain * voice.velocity;
+            // Update grain position and age
+            grain.currentPosition += step;
+            grain.windowPhase += grain.windowPhaseIncrement;
+            grain.age++;
             
-            // Add to temp buffer
-            for (int channel = 0; channel < tempBuffer.getNumChannels(); ++channel)
-                tempBuffer.addSample(channel, sample, sampleValue);
-            
-            maxLevel = std::max(maxLevel, std::abs(sampleValue));
+            grain.isActive = grain.age < grain.grainLength;
+            grainFinished |= !grain.isActive;
+        }
+        
+        for (int channel = 0; channel < MAX_OUTPUT_CHANNELS; ++channel)
+            voiceData[channel][sample] = static_cast<float>(frame[channel]);
+        
+        updateGrains<HoldMode, Looping>(voice, grainFinished, context);
+    }
+    
+    return processVoiceChain<PitchUp>(voice, scratch, context, numSamples);
+}
+
+float SamplePlayer::renderPhaseVocoderVoice(Voice& voice, VoiceScratch& scratch, const RenderContext& context, int numSamples)
+{
+    float* voiceData[MAX_OUTPUT_CHANNELS];
+    for (int channel = 0; channel < MAX_OUTPUT_CHANNELS; ++channel)
+        voiceData[channel] = scratch.channels[channel].data();
+    
+    PhaseVocoder::Source source;
+    source.channels = context.sourceChannels;
+    source.numChannels = context.numSourceChannels;
+    source.length = context.sourceLength;
+    source.looping = isLooping;
+    
+    // A held voice reads the sample's spectral index when one is ready,
+    // rather than analysing the same frames every hop. Offline renders
+    // analyse, as the index is quantized and may still be building.
+    const bool useIndex = isHoldMode && !liveInputActive && !renderQuality.highPrecision;
+    
+    // Hops are synthesised as the block needs them. The analysis position
+    // moves at the playback speed only; the note sets the pitch.
+    for (int done = 0; done < numSamples;)
+    {
+        if (voice.phaseVocoder.getNumReady() == 0)
+        {
+            for (int channel = 0; channel < context.numSourceChannels; ++channel)
+            {
+                if (!useIndex || !spectralIndex.decode(sampleVersion, channel, voice.position, scratch.vocoder))
+                    PhaseVocoder::analyse(source, channel, voice.position, scratch.vocoder);
+                voice.phaseVocoder.synthesise(channel, voice.pitchRatio, scratch.vocoder);
+            }
+            voice.phaseVocoder.finishHop();
             
-            // Update grains
-            updateGrains(voice);
+            if (!isHoldMode)
+            {
+                const bool wasInside = voice.position < context.sourceLength;
+                voice.position += playbackSpeed * PhaseVocoder::HOP_SIZE;
+                
+                if (isLooping && context.sourceLength > 0)
+                    voice.position = std::fmod(voice.position, static_cast<double>(context.sourceLength));
+                else if (wasInside && voice.position >= context.sourceLength && playbackMode == PlaybackMode::Polyphonic)
+                    voice.envelope.noteOff();
+            }
         }
+        
+        float* destination[MAX_OUTPUT_CHANNELS];
+        for (int channel = 0; channel < MAX_OUTPUT_CHANNELS; ++channel)
+            destination[channel] = voiceData[channel] + done;
+        done += voice.phaseVocoder.read(destination, context.numSourceChannels, numSamples - done);
+    }
+    
+    // Placed at the pan centre; a mono source feeds both channels
+    const auto panGains = getPanGains(pan);
+    for (int channel = MAX_OUTPUT_CHANNELS - 1; channel >= 0; --channel)
+    {
+        const float* rendered = voiceData[std::min(channel, context.numSourceChannels - 1)];
+        juce::FloatVectorOperations::copyWithMultiply(voiceData[channel], rendered, panGains[channel], numSamples);
+    }
+    
+    return voice.pitchRatio > 1.0 ? processVoiceChain<true>(voice, scratch, context, numSamples)
+                                   : processVoiceChain<false>(voice, scratch, context, numSamples);
+}
+
+float SamplePlayer::renderPooledVoice(Voice& voice, VoiceScratch& scratch, const RenderContext& context, int numSamples)
+{
+    float* voiceData[MAX_OUTPUT_CHANNELS];
+    for (int channel = 0; channel < MAX_OUTPUT_CHANNELS; ++channel)
+    {
+        voiceData[channel] = scratch.channels[channel].data();
+        juce::FloatVectorOperations::clear(voiceData[channel], numSamples);
     }
     
-    // Final output processing
-    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    DSPKernels::GrainSource source;
+    for (int channel = 0; channel < MAX_OUTPUT_CHANNELS; ++channel)
+        source.channels[channel] = context.sourceChannels[channel];
+    source.stereo = context.numSourceChannels > 1;
+    source.length = context.sourceLength;
+    source.looping = isLooping;
+    source.window = renderedSynthesisMode == SynthesisMode::Psola
+                  ? windowTables[static_cast<size_t>(DSPUtils::GrainWindow::Shape::Hann)].data()
+                  : context.window->data();
+    
+    grainCloud.render(static_cast<int>(&voice - voices.data()), source, voiceData, numSamples);
+    
+    return voice.pitchRatio > 1.0 ? processVoiceChain<true>(voice, scratch, context, numSamples)
+                                   : processVoiceChain<false>(voice, scratch, context, numSamples);
+}
+
+void SamplePlayer::schedulePooledGrains(const RenderContext& context, int numSamples)
+{
+    // A voice stolen or restarted for a new note keeps its old grains, which
+    // play out under their windows instead of cutting off mid-grain
+    for (size_t i = 0; i < voices.size(); ++i)
     {
-        float* outBuffer = buffer.getWritePointer(channel, startSample);
-        const float* tempData = tempBuffer.getReadPointer(channel);
+        if (voices[i].releasePooledGrains && !voices[i].isActive)
+            grainCloud.releaseVoice(static_cast<int>(i));
+        voices[i].releasePooledGrains = false;
+    }
+    grainCloud.releaseFinished();
+    
+    // Grains already playing come out of the block's budget first. The rest
+    // is shared out evenly between the active voices, each passing what it
+    // doesn't spend on to the voices after it, so the first voices can't
+    // starve the others
+    int budget = renderQuality.maxCloudGrains * numSamples - grainCloud.getBlockCost(numSamples);
+    auto numWaiting = std::count_if(voices.begin(), voices.end(), [](const Voice& voice) { return voice.isActive; });
+    
+    for (size_t i = 0; i < voices.size(); ++i)
+    {
+        if (!voices[i].isActive)
+            continue;
+        
+        const int share = budget / static_cast<int>(numWaiting--);
+        int unspent = share;
+        
+        if (renderedSynthesisMode == SynthesisMode::Psola)
+            spawnPsolaGrains(voices[i], static_cast<int>(i), context, numSamples, unspent);
+        else if (renderedSynthesisMode == SynthesisMode::Concatenative)
+            spawnConcatenativeGrains(voices[i], static_cast<int>(i), context, numSamples, unspent);
+        else
+            spawnCloudGrains(voices[i], static_cast<int>(i), context, numSamples, unspent);
+        
+        budget -= share - unspent;
+    }
+}
+
+void SamplePlayer::spawnCloudGrains(Voice& voice, int voiceIndex, const RenderContext& context, int numSamples, int& budget)
+{
+    const int sourceLength = context.sourceLength;
+    const double step = voice.pitchRatio * playbackSpeed;
+    const double interval = currentSampleRate / cloudDensity;
+    
+    // Onsets keep their spacing across blocks; those the pool or the budget
+    // can't take are skipped, thinning the cloud rather than delaying it
+    const int numOnsets = voice.nextPooledGrain < numSamples ? static_cast<int>(std::ceil((numSamples - voice.nextPooledGrain) / interval)) : 0;
+    const int numGrains = std::min(numOnsets, GrainCloud::MAX_GRAINS);
+    
+    // Uncorrelated grains add in power, so the level is kept near that of two overlapping grains
+    const float densityGain = std::sqrt(std::min(1.0f, 2.0f / (cloudDensity * voice.grainDuration)));
+    
+    float* jitter = cloudJitter.data();
+    voice.cloudRandom.fillBipolar(jitter, numGrains * 4);
+    grainCloud.beginAdding(voiceIndex);
+    
+    for (int i = 0; i < numGrains; ++i)
+    {
+        const float* random = jitter + i * 4;
+        const int onset = std::min(numSamples - 1, static_cast<int>(voice.nextPooledGrain + i * interval));
+        
+        const float duration = juce::jlimit(MIN_GRAIN_DURATION, MAX_GRAIN_DURATION, voice.grainDuration * (1.0f + durationJitter * random[0]));
+        const int length = std::max(1, juce::roundToInt(duration * currentSampleRate));
+        const int cost = std::min(length, numSamples - onset);
+        if (cost > budget)
+            continue;
+        
+        double position = (isHoldMode ? voice.position : voice.position + step * onset) + positionJitter * random[1] * currentSampleRate;
+        if (isLooping && sourceLength > 0)
+            position -= std::floor(position / sourceLength) * sourceLength;
+        else
+            position = juce::jlimit(0.0, std::max(0.0, sourceLength - 1.0), position);
+        position = snapGrainStart(position);
+        
+        GrainCloud::GrainStart grain;
+        grain.position = position;
+        grain.step = static_cast<float>(step * std::exp2(pitchJitter * random[2] * (1.0f / 12.0f)));
+        grain.length = length;
+        grain.windowIncrement = DSPUtils::WindowTable::getPhaseIncrement(length);
+        grain.gains = getPanGains(juce::jlimit(-1.0f, 1.0f, pan + spread * random[3]));
+        for (auto& gain : grain.gains)
+            gain *= densityGain;
+        grain.delay = onset;
+        
+        if (!grainCloud.add(grain))
+            break;
+        budget -= cost;
+    }
+    
+    voice.nextPooledGrain += numOnsets * interval - numSamples;
+    advancePooledVoice(voice, step, sourceLength, numSamples);
+}
+
+void SamplePlayer::spawnPsolaGrains(Voice& voice, int voiceIndex, const RenderContext& context, int numSamples, int& budget)
+{
+    // As in the phase vocoder, the position moves at the playback speed only
+    // and the note sets the pitch: grains are taken a period apart and
+    // played a period divided by the pitch ratio apart
+    const int sourceLength = context.sourceLength;
+    const double speed = playbackSpeed;
+    const float fallbackPeriod = static_cast<float>(PSOLA_FALLBACK_SECONDS * currentSampleRate);
+    
+    // Pitching up overlaps more grains per period, so each is turned down to match
+    auto gains = getPanGains(pan);
+    for (auto& gain : gains)
+        gain *= static_cast<float>(1.0 / std::max(1.0, voice.pitchRatio));
+    
+    grainCloud.beginAdding(voiceIndex);
+    double time = voice.nextPooledGrain;
+    
+    while (time < numSamples)
+    {
+        double position = isHoldMode ? voice.position : voice.position + speed * time;
+        if (isLooping && sourceLength > 0)
+            position -= std::floor(position / sourceLength) * sourceLength;
         
-        for (int sample = 0; sample < numSamples; ++sample)
+        // Off the ends of a sample that doesn't loop there is nothing to
+        // mark, and the nearest mark would repeat as a drone
+        if (!isLooping && (position < 0.0 || position >= sourceLength))
         {
-            outBuffer[sample] = outputLimiter.process(tempData[sample]);
+            time += std::max(1.0, fallbackPeriod / voice.pitchRatio);
+            continue;
+        }
+        
+        // Until the marks are ready, and on live input, grains fall on a fixed grid instead
+        PitchMarkIndex::Mark mark;
+        if (liveInputActive || !pitchMarks.findNearest(sampleVersion, position, mark))
+        {
+            mark.position = static_cast<int>(std::floor(position));
+            mark.period = fallbackPeriod;
         }
+        
+        const int onset = static_cast<int>(time);
+        const double fraction = time - onset;
+        const int period = std::max(1, juce::roundToInt(mark.period));
+        const int cost = std::min(2 * period, numSamples - onset);
+        time += std::max(1.0, mark.period / voice.pitchRatio);
+        
+        if (cost > budget)
+            continue;
+        
+        // A period either side of the mark, read a fraction of a sample early
+        // so it lands exactly on the output time
+        GrainCloud::GrainStart grain;
+        grain.position = mark.position - period - fraction;
+        if (isLooping && grain.position < 0.0)
+            grain.position += sourceLength;  // The kernel only wraps past the end
+        grain.step = 1.0f;
+        grain.length = 2 * period;
+        grain.windowIncrement = DSPUtils::WindowTable::getPhaseIncrement(grain.length);
+        grain.gains = gains;
+        grain.delay = onset;
+        
+        if (grainCloud.add(grain))
+            budget -= cost;
     }
     
-    currentLevel.store(maxLevel);
+    voice.nextPooledGrain = time - numSamples;
+    advancePooledVoice(voice, speed, sourceLength, numSamples);
+}
+
+void SamplePlayer::spawnConcatenativeGrains(Voice& voice, int voiceIndex, const RenderContext& context, int numSamples, int& budget)
+{
+    const int sourceLength = context.sourceLength;
+    const double interval = currentSampleRate / cloudDensity;
+    const int length = std::max(1, juce::roundToInt(voice.grainDuration * currentSampleRate));
+    const float densityGain = std::sqrt(std::min(1.0f, 2.0f / (cloudDensity * voice.grainDuration)));
+    
+    auto gains = getPanGains(pan);
+    for (auto& gain : gains)
+        gain *= densityGain;
+    
+    // The targets are read once a block, so a CC takes effect from the next one
+    auto target = descriptorTargets;
+    target[static_cast<size_t>(Descriptor::Pitch)] = voice.midiNote / 127.0f;
+    
+    // Until the index is ready, and on live input, grains follow the voice's position instead
+    const bool matching = !liveInputActive && descriptorIndex.isReady(sampleVersion);
+    
+    grainCloud.beginAdding(voiceIndex);
+    double time = voice.nextPooledGrain;
+    
+    for (; time < numSamples; time += interval)
+    {
+        const int onset = static_cast<int>(time);
+        const int cost = std::min(length, numSamples - onset);
+        if (cost > budget)
+            continue;
+        
+        // Each grain is centred on the nearest frame. Voiced frames are
+        // retuned to the note when pitch counts; the rest play as recorded.
+        DescriptorIndex::Frame frame;
+        double position = voice.position;
+        double step = voice.pitchRatio;
+        if (matching && descriptorIndex.findNearest(sampleVersion, target, descriptorWeights, frame))
+        {
+            const bool retune = frame.note > 0.0f && descriptorWeights[static_cast<size_t>(Descriptor::Pitch)] > 0.0f;
+            step = retune ? std::exp2((voice.midiNote - frame.note) / 12.0) : 1.0;
+            position = frame.position + 0.5 * (DescriptorIndex::FRAME_SIZE - length * step);
+        }
+        else if (!isHoldMode)
+        {
+            position += playbackSpeed * onset;
+        }
+        
+        if (isLooping && sourceLength > 0)
+            position -= std::floor(position / sourceLength) * sourceLength;
+        else
+            position = juce::jlimit(0.0, std::max(0.0, sourceLength - 1.0), position);
+        
+        GrainCloud::GrainStart grain;
+        grain.position = position;
+        grain.step = static_cast<float>(step);
+        grain.length = length;
+        grain.windowIncrement = DSPUtils::WindowTable::getPhaseIncrement(length);
+        grain.gains = gains;
+        grain.delay = onset;
+        
+        if (grainCloud.add(grain))
+            budget -= cost;
+    }
+    
+    voice.nextPooledGrain = time - numSamples;
+    if (!matching)
+        advancePooledVoice(voice, playbackSpeed, sourceLength, numSamples);
+}
+
+void SamplePlayer::advancePooledVoice(Voice& voice, double step, int sourceLength, int numSamples)
+{
+    if (isHoldMode)
+        return;
+    
+    const bool wasInside = voice.position < sourceLength;
+    voice.position += step * numSamples;
+    
+    if (isLooping && sourceLength > 0)
+        voice.position = std::fmod(voice.position, static_cast<double>(sourceLength));
+    else if (wasInside && voice.position >= sourceLength && playbackMode == PlaybackMode::Polyphonic)
+        voice.envelope.noteOff();
+}
+
+template <bool PitchUp>
+float SamplePlayer::processVoiceChain(Voice& voice, VoiceScratch& scratch, const RenderContext& context, int numSamples)
+{
+    // Envelope and velocity are shared by the channels
+    float* gains = scratch.gains.data();
+    voice.envelope.process(gains, numSamples);
+    juce::FloatVectorOperations::multiply(gains, voice.velocity, numSamples);
+    
+    // A mono source played centred and without spread gives identical
+    // channels. While the chains' state matches too, those run through the
+    // first chain only and the result is copied, the others' state following
+    // along; the first block that differs splits them until the next note.
+    const float* first = scratch.channels[0].data();
+    const bool shareChain = voice.chainsLinked
+                         && std::all_of(scratch.channels.begin() + 1, scratch.channels.end(),
+                                        [first, numSamples](const DSPUtils::FloatBlock& channel)
+                                        { return std::equal(first, first + numSamples, channel.data()); });
+    voice.chainsLinked = shareChain;
+    
+    // Voice processing chain, one block pass per stage and channel
+    const int numChains = shareChain ? 1 : MAX_OUTPUT_CHANNELS;
+    for (int channel = 0; channel < numChains; ++channel)
+    {
+        auto& chain = voice.chains[channel];
+        float* channelData = scratch.channels[channel].data();
+        
+        if constexpr (PitchUp)
+        {
+            chain.antiAliasFilter.setCutoff(std::min(20000.0f, static_cast<float>(20000.0 / voice.pitchRatio)));
+            chain.antiAliasFilter.process(channelData, numSamples);
+        }
+        
+        chain.dcBlocker.process(channelData, numSamples);
+        chain.softClipper.setOversamplingFactor(getRequestedOversamplingFactor());
+        chain.softClipper.process(channelData, numSamples);
+    }
+    
+    if (shareChain)
+    {
+        for (int channel = 1; channel < MAX_OUTPUT_CHANNELS; ++channel)
+        {
+            std::copy_n(first, numSamples, scratch.channels[channel].data());
+            voice.chains[channel].copyStateFrom(voice.chains[0]);
+        }
+    }
+    
+    float peak = 0.0f;
+    for (int channel = 0; channel < MAX_OUTPUT_CHANNELS; ++channel)
+    {
+        float* channelData = scratch.channels[channel].data();
+        if (context.mix[channel] != nullptr)
+            kernels->multiplyAndMix(context.mix[channel], channelData, gains, numSamples);
+        else
+            kernels->multiply(channelData, channelData, gains, numSamples);
+        
+        const auto range = juce::FloatVectorOperations::findMinAndMax(channelData, numSamples);
+        peak = std::max({ peak, -range.getStart(), range.getEnd() });
+    }
+    
+    return peak;
 }
 
 void SamplePlayer::handleMidiMessage(const juce::MidiMessage& message)
 {
-    // Check if a sample is loaded
-    if (fileBuffer.getNumSamples() == 0)
+    // Descriptor targets follow their CCs whatever the mode, so they're set
+    // before concatenative mode is chosen
+    if (message.isController())
+    {
+        const int descriptor = message.getControllerNumber() - FIRST_DESCRIPTOR_CC;
+        if (descriptor >= 0 && descriptor < DescriptorIndex::NUM_DESCRIPTORS)
+            setDescriptorTarget(static_cast<Descriptor>(descriptor), message.getControllerValue() / 127.0f);
+        return;
+    }
+    
+    // Check if there is anything to play
+    if (!hasSource())
         return;
 
     if (message.isNoteOn())
@@ -245,10 +1046,27 @@ void SamplePlayer::handleMidiMessage(const juce::MidiMessage& message)
                 break;
                 
             case PlaybackMode::Monophonic:
-                // Stop any existing voices before starting new one
-                stopAllVoices();
-                startVoice(message.getNoteNumber(), message.getFloatVelocity());
+            {
+                // Restart the sounding voice in place, so its envelope picks up
+                // from the current level instead of cutting to silence
+                auto sounding = std::find_if(voices.begin(), voices.end(),
+                                             [](const Voice& voice) { return voice.isActive; });
+                if (sounding == voices.end())
+                {
+                    startVoice(message.getNoteNumber(), message.getFloatVelocity());
+                    break;
+                }
+                
+                for (auto& voice : voices)
+                {
+                    if (voice.isActive && &voice != &*sounding)
+                        voice.envelope.noteOff();
+                }
+                
+                sounding->position = isHoldMode ? holdPosition : 0.0;
+                triggerVoice(*sounding, message.getNoteNumber(), message.getFloatVelocity());
                 break;
+            }
                 
             case PlaybackMode::OneShot:
                 // Start a new voice without stopping others
@@ -301,22 +1119,42 @@ void SamplePlayer::startVoice(int midiNoteNumber, float velocity)
         voice.reset();
         
         voice.isActive = true;
-        voice.midiNote = midiNoteNumber;
-        voice.velocity = velocity;
         voice.position = isHoldMode ? holdPosition : 0.0;
-        
-        // Calculate pitch ratio from MIDI note
-        const float noteRatio = std::pow(2.0f, (midiNoteNumber - 60) / 12.0f);
-        voice.pitchRatio = noteRatio;
-        
-        // In OneShot and Monophonic modes, we don't use the envelope release
-        if (playbackMode == PlaybackMode::OneShot || playbackMode == PlaybackMode::Monophonic)
-        {
-            voice.envelope.sustainLevel = 1.0f;  // Full sustain
-            voice.envelope.releaseTime = 0.5f;   // Longer release for smoother stop
-        }
-        
-        voice.envelope.noteOn();
+        triggerVoice(voice, midiNoteNumber, velocity);
+    }
+}
+
+void SamplePlayer::triggerVoice(Voice& voice, int midiNoteNumber, float velocity)
+{
+    voice.midiNote = midiNoteNumber;
+    voice.velocity = velocity;
+    
+    // Calculate pitch ratio from MIDI note
+    const float noteRatio = std::pow(2.0f, (midiNoteNumber - 60) / 12.0f);
+    voice.pitchRatio = noteRatio;
+    
+    // In OneShot and Monophonic modes, we don't use the envelope release
+    if (playbackMode == PlaybackMode::OneShot || playbackMode == PlaybackMode::Monophonic)
+    {
+        voice.envelope.sustainLevel = 1.0f;  // Full sustain
+        voice.envelope.releaseTime = 0.5f;   // Longer release for smoother stop
+    }
+    
+    const auto seed = grainRandom.nextInt64();
+    voice.grainRandom.setSeed(seed);
+    voice.cloudRandom.setSeed(static_cast<uint64_t>(seed));
+    voice.envelope.curve = envelopeCurve;
+    voice.envelope.noteOn();
+    
+    // The vocoder fades in over its first hops, so it starts that much
+    // playback early and the note's position comes out at full level
+    // PhaseVocoder::LATENCY samples later, as getLatencySamples() reports
+    if (synthesisMode == SynthesisMode::PhaseVocoder && !isHoldMode)
+    {
+        const int length = getSourceLength();
+        voice.position -= playbackSpeed * PhaseVocoder::LATENCY;
+        if (isLooping && length > 0)
+            voice.position = std::fmod(std::fmod(voice.position, static_cast<double>(length)) + length, static_cast<double>(length));
     }
 }
 
@@ -335,51 +1173,135 @@ void SamplePlayer::stopVoice(int midiNoteNumber)
     }
 }
 
-void SamplePlayer::updateGrains(Voice& voice)
+template <bool HoldMode, bool Looping>
+void SamplePlayer::updateGrains(Voice& voice, bool grainFinished, const RenderContext& context)
 {
+    const int sourceLength = context.sourceLength;
+    
     // Remove inactive grains
-    voice.grains.erase(
-        std::remove_if(voice.grains.begin(), voice.grains.end(),
-            [](const Grain& g) { return !g.isActive; }),
-        voice.grains.end()
-    );
+    if (grainFinished)
+    {
+        voice.grains.removeInactive();
+    }
     
     // Create new grains as needed
-    if (voice.grains.empty() || 
-        voice.grains.back().phase >= voice.grainOverlap)
+    if (!voice.grains.full() && voice.grains.size() < renderQuality.maxGrainsPerVoice &&
+        (voice.grains.empty() || voice.grains.back().phase >= voice.grainOverlap))
     {
         Grain newGrain;
-        newGrain.startPosition = voice.position;
-        newGrain.currentPosition = voice.position;
+        newGrain.startPosition = snapGrainStart(voice.position);
+        newGrain.currentPosition = newGrain.startPosition;
         newGrain.grainLength = voice.grainDuration * currentSampleRate;
+        newGrain.windowPhaseIncrement = DSPUtils::WindowTable::getPhaseIncrement(newGrain.grainLength);
         newGrain.isActive = true;
         
         // Calculate initial phase and phase increment for alignment
-        newGrain.initialPhase = static_cast<float>(std::fmod(voice.position, 2.0 * M_PI));
-        newGrain.phaseIncrement = static_cast<float>(2.0 * M_PI * voice.pitchRatio / newGrain.grainLength);
+        newGrain.initialPhase = std::fmod(newGrain.startPosition, 2.0 * M_PI);
+        newGrain.phaseIncrement = 2.0 * M_PI * voice.pitchRatio / newGrain.grainLength;
+        
+        // Place the grain within the spread around the pan centre
+        newGrain.panGains = getPanGains(juce::jlimit(-1.0f, 1.0f, pan + spread * (voice.grainRandom.nextFloat() * 2.0f - 1.0f)));
+        
+        // A held voice keeps spawning the same grain, so it can come from the cache
+        if constexpr (HoldMode)
+        {
+            if (!renderQuality.highPrecision)
+                assignGrainCache(voice, newGrain, context);
+        }
         
         voice.grains.push_back(newGrain);
     }
     
     // Update voice position
-    if (!isHoldMode)
+    if constexpr (!HoldMode)
     {
+        const bool wasInside = voice.position < sourceLength;
         voice.position += voice.pitchRatio * playbackSpeed;
         
         // Handle looping
-        if (isLooping && voice.position >= fileBuffer.getNumSamples())
+        if constexpr (Looping)
         {
-            voice.position = 0.0;
+            if (voice.position >= sourceLength)
+                voice.position = 0.0;
         }
-        else if (!isLooping && voice.position >= fileBuffer.getNumSamples())
+        else
         {
-            stopVoice(voice.midiNote);
+            // Only the sample that runs off the end releases the voice. Only
+            // this voice, so voices can render on separate threads.
+            if (wasInside && voice.position >= sourceLength && playbackMode == PlaybackMode::Polyphonic)
+                voice.envelope.noteOff();
         }
     }
 }
 
+void SamplePlayer::assignGrainCache(Voice& voice, Grain& grain, const RenderContext& context)
+{
+    auto& cache = voice.grainCache;
+    const double step = voice.pitchRatio * playbackSpeed;
+    
+    // Everything the rendered waveform depends on, apart from the per-grain pan
+    const bool matches = cache.length > 0
+                      && cache.startPosition == grain.startPosition
+                      && cache.pitchRatio == voice.pitchRatio
+                      && cache.step == step
+                      && cache.grainLength == grain.grainLength
+                      && cache.window == context.window
+                      && cache.interpolationPoints == voice.resampler.getNumPoints()
+                      && cache.numSourceChannels == context.numSourceChannels
+                      && cache.sourceVersion == context.sourceVersion;
+    
+    if (matches)
+    {
+        grain.cacheRole = Grain::CacheRole::Replay;
+        grain.cacheGeneration = cache.generation;
+        return;
+    }
+    
+    const int length = static_cast<int>(std::ceil(grain.grainLength));
+    if (length > static_cast<int>(cache.channels.front().size()))
+        return;
+    
+    // A new key: this grain renders live and records itself as it plays.
+    // Grains still replaying the old generation fall back to live rendering.
+    ++cache.generation;
+    cache.numRendered = 0;
+    cache.length = length;
+    cache.startPosition = grain.startPosition;
+    cache.pitchRatio = voice.pitchRatio;
+    cache.step = step;
+    cache.grainLength = grain.grainLength;
+    cache.window = context.window;
+    cache.interpolationPoints = voice.resampler.getNumPoints();
+    cache.numSourceChannels = context.numSourceChannels;
+    cache.sourceVersion = context.sourceVersion;
+    
+    grain.cacheRole = Grain::CacheRole::Record;
+    grain.cacheGeneration = cache.generation;
+}
+
+double SamplePlayer::snapGrainStart(double position) const
+{
+    if (grainSnap == GrainSnap::Off || liveInputActive)
+        return position;
+    
+    const auto mark = static_cast<OnsetIndex::Mark>(static_cast<int>(grainSnap) - 1);
+    const double nearest = onsetIndex.findNearest(sampleVersion, mark, position, snapRange * fileSampleRate);
+    return position + snapStrength * (nearest - position);
+}
+
+std::array<float, SamplePlayer::MAX_OUTPUT_CHANNELS> SamplePlayer::getPanGains(float panPosition)
+{
+    const float panAngle = (panPosition + 1.0f) * juce::MathConstants<float>::pi * 0.25f;
+    return { juce::MathConstants<float>::sqrt2 * std::cos(panAngle),
+             juce::MathConstants<float>::sqrt2 * std::sin(panAngle) };
+}
+
 int SamplePlayer::findFreeVoice() const
 {
+    const auto numActive = std::count_if(voices.begin(), voices.end(), [](const Voice& voice) { return voice.isActive; });
+    if (numActive >= renderQuality.maxVoices)
+        return -1;
+    
     for (size_t i = 0; i < voices.size(); ++i)
     {
         if (!voices[i].isActive)
@@ -396,7 +1318,7 @@ void SamplePlayer::stealVoice()
     
     for (size_t i = 0; i < voices.size(); ++i)
     {
-        if (voices[i].envelope.currentLevel < lowestLevel)
+        if (voices[i].isActive && voices[i].envelope.currentLevel < lowestLevel)
         {
             lowestLevel = voices[i].envelope.currentLevel;
             stealIndex = static_cast<int>(i);
@@ -406,6 +1328,60 @@ void SamplePlayer::stealVoice()
     voices[stealIndex].reset();
 }
 
+void SamplePlayer::setRenderQuality(const RenderQuality& quality)
+{
+    renderQuality = quality;
+    renderQuality.maxVoices = juce::jlimit(1, MAX_VOICES, quality.maxVoices);
+    renderQuality.maxGrainsPerVoice = juce::jlimit(1, MAX_GRAINS_PER_VOICE, quality.maxGrainsPerVoice);
+    
+    for (auto& voice : voices)
+        voice.resampler.setNumPoints(renderQuality.interpolationPoints);
+    
+    releaseVoicesOverLimit();
+}
+
+void SamplePlayer::releaseVoicesOverLimit()
+{
+    // Surplus voices fade out over their release rather than cutting off
+    using State = Voice::Envelope::State;
+    const auto isHeld = [](const Voice& voice)
+    {
+        return voice.isActive && voice.envelope.state != State::Release && voice.envelope.state != State::Idle;
+    };
+    auto numHeld = std::count_if(voices.begin(), voices.end(), isHeld);
+    
+    for (; numHeld > renderQuality.maxVoices; --numHeld)
+    {
+        Voice* quietest = nullptr;
+        for (auto& voice : voices)
+        {
+            if (isHeld(voice) && (quietest == nullptr || voice.envelope.currentLevel < quietest->envelope.currentLevel))
+                quietest = &voice;
+        }
+        
+        quietest->envelope.noteOff();
+    }
+}
+
+SamplePlayer::RenderQuality SamplePlayer::getNonRealtimeQuality()
+{
+    RenderQuality quality;
+    quality.interpolationPoints = DSPUtils::Resampler::MAX_SINC_POINTS;
+    quality.minOversamplingFactor = 1 << DSPUtils::SoftClipper::MAX_STAGES;
+    quality.maxCloudGrains = GrainCloud::MAX_GRAINS;
+    quality.highPrecision = true;
+    return quality;
+}
+
+int SamplePlayer::getLatencySamples() const
+{
+    // Every voice runs the same clipper configuration, which may not have
+    // reached the voices yet, so the latency follows the requested factor
+    return juce::roundToInt(DSPUtils::SoftClipper::getLatencyForFactor(getRequestedOversamplingFactor()))
+         + outputLimiter.getLatencyInSamples()
+         + (synthesisMode == SynthesisMode::PhaseVocoder ? PhaseVocoder::LATENCY : 0);
+}
+
 void SamplePlayer::setHoldMode(bool shouldHold)
 {
     isHoldMode = shouldHold;
@@ -424,9 +1400,9 @@ void SamplePlayer::setHoldMode(bool shouldHold)
 
 void SamplePlayer::setHoldPosition(double normalizedPosition)
 {
-    if (fileBuffer.getNumSamples() > 0)
+    if (getSourceLength() > 0)
     {
-        holdPosition = normalizedPosition * fileBuffer.getNumSamples();
+        holdPosition = normalizedPosition * getSourceLength();
         if (isHoldMode)
         {
             for (auto& voice : voices)
@@ -442,8 +1418,8 @@ void SamplePlayer::setHoldPosition(double normalizedPosition)
 
 double SamplePlayer::getHoldPosition() const
 {
-    return fileBuffer.getNumSamples() > 0 ? 
-        holdPosition / fileBuffer.getNumSamples() : 0.0;
+    return getSourceLength() > 0 ? 
+        holdPosition / getSourceLength() : 0.0;
 }
 
 double SamplePlayer::getCurrentPosition() const
@@ -453,7 +1429,7 @@ double SamplePlayer::getCurrentPosition() const
         if (voice.isActive)
         {
             return voice.position / 
-                (fileBuffer.getNumSamples() > 0 ? fileBuffer.getNumSamples() : 1);
+                (getSourceLength() > 0 ? getSourceLength() : 1);
         }
     }
     return 0.0;
@@ -473,10 +1449,10 @@ void SamplePlayer::stopAllVoices()
         }
     }
     
-    // Process one block to ensure release
-    juce::AudioBuffer<float> tempBuffer(2, 512);
-    tempBuffer.clear();
-    processBlock(tempBuffer, 0, tempBuffer.getNumSamples());
+    // The voices are silent immediately, so only the limiter needs clearing.
+    // Rendering a throwaway block here would allocate on the audio thread and
+    // overrun tempBuffer whenever the host block is shorter than it.
+    outputLimiter.reset();
 }
 
 void SamplePlayer::Voice::Envelope::setParameters(float attack, float decay, float sustain, float release, float sr)
@@ -488,73 +1464,114 @@ void SamplePlayer::Voice::Envelope::setParameters(float attack, float decay, flo
     sampleRate = sr;
 }
 
-float SamplePlayer::Voice::Envelope::process()
+void SamplePlayer::Voice::Envelope::process(float* gains, int numSamples)
 {
-    float targetLevel = 0.0f;
-    float timeInc = 1.0f / sampleRate;
+    int done = 0;
     
-    switch (state)
+    while (done < numSamples)
     {
-        case State::Attack:
-            currentTime += timeInc;
-            currentLevel = currentTime / attackTime;
-            if (currentLevel >= 1.0f)
-            {
-                currentLevel = 1.0f;
-                state = State::Decay;
-                currentTime = 0.0f;
-            }
-            break;
+        const bool holding = state == State::Sustain || state == State::Idle;
+        const int count = holding ? numSamples - done : std::min(numSamples - done, samplesRemaining);
+        float* segment = gains + done;
+        
+        if (holding)
+        {
+            juce::FloatVectorOperations::fill(segment, currentLevel, count);
+        }
+        else if (logDecayPerSample != 0.0f)
+        {
+            const float target = targetLevel;
+            const float distance = currentLevel - targetLevel;
+            for (int i = 0; i < count; ++i)
+                segment[i] = target + distance * DSPUtils::FastMath::exp(logDecayPerSample * static_cast<float>(i + 1));
+        }
+        else
+        {
+            const float start = currentLevel;
+            for (int i = 0; i < count; ++i)
+                segment[i] = start + increment * static_cast<float>(i + 1);
+        }
+        
+        currentLevel = segment[count - 1];
+        done += count;
+        
+        if (holding)
+            continue;
+        
+        samplesRemaining -= count;
+        if (samplesRemaining == 0)
+        {
+            segment[count - 1] = currentLevel = targetLevel;
             
-        case State::Decay:
-            currentTime += timeInc;
-            currentLevel = 1.0f - (1.0f - sustainLevel) * (currentTime / decayTime);
-            if (currentLevel <= sustainLevel)
+            switch (state)
             {
-                currentLevel = sustainLevel;
-                state = State::Sustain;
+                case State::Attack:  enterState(State::Decay); break;
+                case State::Decay:   enterState(State::Sustain); break;
+                case State::Release: enterState(State::Idle); break;
+                case State::Sustain:
+                case State::Idle:
+                    break;
             }
-            break;
+        }
+    }
+}
+
+void SamplePlayer::Voice::Envelope::enterState(State newState)
+{
+    // Exponential segments end at -60 dB of their starting distance, then snap to the target
+    static constexpr float exponentialEnd = -6.9077553f;  // ln(0.001)
+    
+    state = newState;
+    increment = 0.0f;
+    logDecayPerSample = 0.0f;
+    
+    switch (state)
+    {
+        case State::Attack:
+            // A retrigger only covers the remaining distance, at the usual slope
+            targetLevel = 1.0f;
+            samplesRemaining = std::max(1, juce::roundToInt((1.0f - currentLevel) * attackTime * sampleRate));
+            increment = (targetLevel - currentLevel) / static_cast<float>(samplesRemaining);
+            return;
             
-        case State::Sustain:
-            currentLevel = sustainLevel;
+        case State::Decay:
+            targetLevel = sustainLevel;
+            samplesRemaining = std::max(1, juce::roundToInt(decayTime * sampleRate));
             break;
             
         case State::Release:
-            currentTime += timeInc;
-            currentLevel = sustainLevel * (1.0f - currentTime / releaseTime);
-            if (currentLevel <= 0.001f)
-            {
-                currentLevel = 0.0f;
-                state = State::Idle;
-            }
+            targetLevel = 0.0f;
+            samplesRemaining = std::max(1, juce::roundToInt(releaseTime * sampleRate));
             break;
             
+        case State::Sustain:
         case State::Idle:
-            currentLevel = 0.0f;
-            break;
+            targetLevel = currentLevel = (state == State::Sustain ? sustainLevel : 0.0f);
+            samplesRemaining = std::numeric_limits<int>::max();
+            return;
     }
     
-    return currentLevel;
+    if (curve == EnvelopeCurve::Exponential)
+        logDecayPerSample = exponentialEnd / static_cast<float>(samplesRemaining);
+    else
+        increment = (targetLevel - currentLevel) / static_cast<float>(samplesRemaining);
 }
 
 void SamplePlayer::Voice::Envelope::noteOn()
 {
-    state = State::Attack;
-    currentTime = 0.0f;
-    if (state == State::Release)
-    {
-        currentTime = (currentLevel / 1.0f) * attackTime;
-    }
+    enterState(State::Attack);
 }
 
 void SamplePlayer::Voice::Envelope::noteOff()
 {
-    if (state != State::Idle)
-    {
-        state = State::Release;
-        currentTime = 0.0f;
-    }
+    if (state != State::Idle && state != State::Release)
+        enterState(State::Release);
+}
+
+void SamplePlayer::Voice::Envelope::reset()
+{
+    currentLevel = 0.0f;
+    enterState(State::Idle);
 }
 
 void SamplePlayer::setPlaybackSpeed(float speed)
@@ -569,13 +1586,15 @@ void SamplePlayer::setLooping(bool shouldLoop)
 
 double SamplePlayer::getLengthInSeconds() const
 {
+    if (liveInputActive)
+        return liveWindowLength / currentSampleRate;
     return fileBuffer.getNumSamples() > 0 ? fileBuffer.getNumSamples() / fileSampleRate : 0.0;
 }
 
 void SamplePlayer::setGrainDuration(float durationInSeconds)
 {
     // Clamp the duration between reasonable values (50ms to 500ms)
-    defaultGrainDuration = std::max(0.05f, std::min(0.5f, durationInSeconds));
+    defaultGrainDuration = juce::jlimit(MIN_GRAIN_DURATION, MAX_GRAIN_DURATION, durationInSeconds);
     
     // Update all voices with the new grain duration
     for (auto& voice : voices)
@@ -2,7 +2,17 @@
 
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_formats/juce_audio_formats.h>
+#include "DSPArena.h"
 #include "DSPUtils.h"
+#include "GrainCloud.h"
+#include "LiveCapture.h"
+#include "OnsetIndex.h"
+#include "PhaseVocoder.h"
+#include "PitchMarkIndex.h"
+#include "DescriptorIndex.h"
+#include "SpectralIndex.h"
+#include <new>
+#include <utility>
 #include <vector>
 
 class SamplePlayer
@@ -14,16 +24,72 @@ public:
         Monophonic,    // Single voice, continues playing after release
         OneShot        // Multiple independent voices, each continues until stopped
     };
+    
+    // How a voice turns the source into sound. Voice allocation, envelope and
+    // output chain are the same for all of them.
+    enum class SynthesisMode {
+        Granular,      // Overlapping windowed grains; speed and pitch move together
+        PhaseVocoder,  // Phase-locked vocoder; speed and pitch are independent
+        Cloud,         // Dense, randomly jittered grains drawn from one pool for all voices
+        Psola,         // Pitch-synchronous grains at the sample's pitch marks; for monophonic material
+        Concatenative  // Grains from the sample's frames nearest a descriptor target
+    };
+    
+    using Descriptor = DescriptorIndex::Descriptor;
+    
+    // What new grains start on, from the marks found in each loaded sample
+    enum class GrainSnap {
+        Off,           // Wherever the voice position is
+        ZeroCrossing,  // Rising zero crossings, against clicks
+        Onset,         // The start of attacks
+        Transient      // The peak of attacks
+    };
+    
+    // Shape of the envelope's decay and release segments; attack is always linear
+    enum class EnvelopeCurve {
+        Linear,
+        Exponential
+    };
+
+    static constexpr int MAX_VOICES = 16;
+    static constexpr int MAX_GRAINS_PER_VOICE = 32;
+    static constexpr float MIN_GRAIN_DURATION = 0.05f;  // Seconds
+    static constexpr float MAX_GRAIN_DURATION = 0.5f;
+    static constexpr float MIN_LIVE_HORIZON = 0.1f;  // Seconds
+    static constexpr float MIN_CLOUD_DENSITY = 1.0f;  // Grains per second per voice
+    static constexpr float MAX_CLOUD_DENSITY = 4000.0f;
+    static constexpr double PSOLA_FALLBACK_SECONDS = 0.005;  // Grain spacing without pitch marks
+    static constexpr int FIRST_DESCRIPTOR_CC = 20;  // CC 20 + a descriptor's index sets its target
+    
+    // Cost against fidelity; the defaults are full real-time quality
+    struct RenderQuality {
+        int interpolationPoints = DSPUtils::Resampler::SINC_POINTS;
+        int minOversamplingFactor = 1;  // Raises the requested factor
+        int maxGrainsPerVoice = MAX_GRAINS_PER_VOICE;
+        int maxVoices = MAX_VOICES;
+        int maxCloudGrains = GrainCloud::MAX_GRAINS / 2;  // Average cloud and PSOLA grains per sample over a block, all voices together
+        bool highPrecision = false;  // Double grain sums and exact phase alignment
+    };
+    
+    // For offline bounces: the long windowed sinc, 4x oversampling and double precision
+    static RenderQuality getNonRealtimeQuality();
 
     SamplePlayer();
     ~SamplePlayer();
 
     void loadFile(const juce::File& file);
+    void loadBuffer(const juce::AudioBuffer<float>& source, double sourceSampleRate);
     void prepareToPlay(double sampleRate, int samplesPerBlock);
     void releaseResources();
     void processBlock(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
     void handleMidiMessage(const juce::MidiMessage& message);
+    
+    // Whether handling the message can start or stop a voice, so it's worth
+    // splitting a block at; everything else only sets parameters
+    static bool changesVoices(const juce::MidiMessage& message) { return message.isNoteOnOrOff(); }
+    
     void setPlaybackSpeed(float speed);
+    float getPlaybackSpeed() const { return playbackSpeed; }
     void setLooping(bool shouldLoop);
     bool getLooping() const { return isLooping; }
     void setHoldMode(bool shouldHold);
@@ -31,6 +97,7 @@ public:
     void setHoldPosition(double normalizedPosition);
     double getHoldPosition() const;
     bool isFileLoaded() const { return fileBuffer.getNumSamples() > 0; }
+    bool hasSource() const { return liveInputActive || isFileLoaded(); }
     double getLengthInSeconds() const;
     float getCurrentLevel() const { return currentLevel.load(); }
     double getCurrentPosition() const;
@@ -41,12 +108,116 @@ public:
     // Grain control
     void setGrainDuration(float durationInSeconds);
     float getGrainDuration() const { return defaultGrainDuration; }
+    // Soft clipper oversampling (1, 2 or 4), applied at the start of the next block
+    void setOversamplingFactor(int factor) { oversamplingFactor = factor; }
+    int getOversamplingFactor() const { return oversamplingFactor; }
+    int getLatencySamples() const;  // Soft clipper, output limiter lookahead and, in vocoder mode, its fade-in
+    
+    void setEnvelopeCurve(EnvelopeCurve curve) { envelopeCurve = curve; }  // Applies from the next note on
+    EnvelopeCurve getEnvelopeCurve() const { return envelopeCurve; }
+    
+    // Stereo placement of new grains: pan is the centre (-1 left .. 1 right),
+    // spread the random per-grain deviation around it (0 .. 1)
+    void setPan(float newPan) { pan = juce::jlimit(-1.0f, 1.0f, newPan); }
+    float getPan() const { return pan; }
+    void setSpread(float newSpread) { spread = juce::jlimit(0.0f, 1.0f, newSpread); }
+    float getSpread() const { return spread; }
+    
+    void setWindowShape(DSPUtils::GrainWindow::Shape shape) { windowShape = shape; }
+    DSPUtils::GrainWindow::Shape getWindowShape() const { return windowShape; }
+
+    // Ask for transparent huge pages behind the real-time state (Linux only),
+    // applied at the next prepareToPlay
+    void setUseHugePages(bool shouldUse) { useHugePages = shouldUse; }
+    bool isUsingHugePages() const { return arena.isHugePageBacked(); }
+    size_t getRealtimeStateSize() const { return arena.getSize(); }
+    
+    // SIMD kernels for this instance's block loops, handed to every
+    // processor at once; unsupported ones fall back to generic. Not while a
+    // block renders.
+    void setKernelISA(DSPKernels::ISA isa);
+    DSPKernels::ISA getKernelISA() const { return kernels->isa; }
+    
+    // Offline rendering: spreads each block's voices over the pool's threads,
+    // with output identical to rendering them on the calling thread. Set it
+    // before prepareToPlay. processBlock waits on the pool, so never use this
+    // from a real-time host.
+    void setVoiceThreadPool(juce::ThreadPool* pool) { voiceThreadPool = pool; }
+
+    // Audio thread. Dropping polyphony releases the quietest surplus voices.
+    void setRenderQuality(const RenderQuality& quality);
+    const RenderQuality& getRenderQuality() const { return renderQuality; }
+
+    // Live input: grains read the plugin input straight from the capture
+    // buffer instead of the loaded sample, reaching back as far as the
+    // horizon. Freezing stops the capture, so the current window plays as a
+    // fixed sample until it's released. All three apply at the next block.
+    void setLiveInput(bool shouldUseInput) { liveInput = shouldUseInput; }
+    bool getLiveInput() const { return liveInput; }
+    void setLiveFrozen(bool shouldFreeze) { liveFrozen = shouldFreeze; }
+    bool getLiveFrozen() const { return liveFrozen; }
+    void setLiveHorizon(float seconds) { liveHorizon = juce::jlimit(MIN_LIVE_HORIZON, LiveCapture::CAPACITY_SECONDS, seconds); }
+    float getLiveHorizon() const { return liveHorizon; }
+    
+    // Audio thread, once per host block before processBlock. Records the
+    // input channels and slides the live window along with them.
+    void captureInput(const juce::AudioBuffer<float>& input, int numInputChannels);
+
+    // Applied at the start of the next block; sounding voices carry on in the
+    // new mode. Message thread: PSOLA and concatenative mode start analysing
+    // the sample for their index.
+    void setSynthesisMode(SynthesisMode mode);
+    SynthesisMode getSynthesisMode() const { return synthesisMode; }
+    
+    // Cloud mode: each voice starts density grains a second, with position,
+    // pitch and duration jittered at random by up to these amounts either
+    // way; pan is jittered by the spread. Grains started afterwards use them.
+    void setCloudDensity(float grainsPerSecond) { cloudDensity = juce::jlimit(MIN_CLOUD_DENSITY, MAX_CLOUD_DENSITY, grainsPerSecond); }
+    float getCloudDensity() const { return cloudDensity; }
+    void setPositionJitter(float seconds) { positionJitter = juce::jlimit(0.0f, 1.0f, seconds); }
+    float getPositionJitter() const { return positionJitter; }
+    void setPitchJitter(float semitones) { pitchJitter = juce::jlimit(0.0f, 12.0f, semitones); }
+    float getPitchJitter() const { return pitchJitter; }
+    void setDurationJitter(float fraction) { durationJitter = juce::jlimit(0.0f, 1.0f, fraction); }  // Of the grain duration
+    float getDurationJitter() const { return durationJitter; }
+    
+    // Grain starts move towards the nearest mark of the chosen kind within the
+    // range, all the way at strength 1 and partway below it. The marks come
+    // from a background pass over each loaded sample; live input never snaps.
+    void setGrainSnap(GrainSnap snap) { grainSnap = snap; }
+    GrainSnap getGrainSnap() const { return grainSnap; }
+    void setSnapRange(float seconds) { snapRange = juce::jlimit(0.0f, 0.5f, seconds); }
+    float getSnapRange() const { return snapRange; }
+    void setSnapStrength(float strength) { snapStrength = juce::jlimit(0.0f, 1.0f, strength); }
+    float getSnapStrength() const { return snapStrength; }
+    
+    // Concatenative mode: each voice starts density grains a second, each from
+    // the sample frame whose descriptors are nearest the targets, all 0..1.
+    // The pitch target is the note played, and a weight of 0 leaves a
+    // descriptor out of the match. The frames come from a background pass
+    // over the sample while the mode is selected.
+    void setDescriptorTarget(Descriptor descriptor, float value) { descriptorTargets[static_cast<size_t>(descriptor)] = juce::jlimit(0.0f, 1.0f, value); }
+    float getDescriptorTarget(Descriptor descriptor) const { return descriptorTargets[static_cast<size_t>(descriptor)]; }
+    void setDescriptorWeight(Descriptor descriptor, float weight) { descriptorWeights[static_cast<size_t>(descriptor)] = juce::jlimit(0.0f, 1.0f, weight); }
+    float getDescriptorWeight(Descriptor descriptor) const { return descriptorWeights[static_cast<size_t>(descriptor)]; }
+    
+    // Analyse each loaded sample into a spectral index in the background, so
+    // held phase vocoder voices resynthesise from it without analysing
+    void setSpectralIndexEnabled(bool shouldBuild);
+    bool getSpectralIndexEnabled() const { return spectralIndexEnabled; }
+    
+    // Message thread. Waits up to timeoutMs each for the indexes still being
+    // built; true once none is. Offline tools call it before rendering, so
+    // the output doesn't depend on how fast the index threads ran.
+    bool waitForIndexes(int timeoutMs);
 
     // Replace trigger mode with playback mode
     void setPlaybackMode(PlaybackMode mode) { playbackMode = mode; }
     PlaybackMode getPlaybackMode() const { return playbackMode; }
 
 private:
+    static constexpr int MAX_OUTPUT_CHANNELS = 2;
+    
     struct Grain {
         double startPosition = 0.0;
         double currentPosition = 0.0;
@@ -54,29 +225,126 @@ private:
         double age = 0.0;
         bool isActive = false;
         float phase = 0.0f;  // Phase for window calculation
+        uint32_t windowPhase = 0;           // Integer window phase, full range = one grain
+        uint32_t windowPhaseIncrement = 0;
         
         // Phase alignment
-        float initialPhase = 0.0f;
-        float phaseIncrement = 0.0f;
+        double initialPhase = 0.0;
+        double phaseIncrement = 0.0;
+        
+        // Constant-power pan, unity on both channels at the centre
+        std::array<float, MAX_OUTPUT_CHANNELS> panGains{ 1.0f, 1.0f };
+        
+        // Hold mode: whether this grain fills the voice's grain cache or plays it back
+        enum class CacheRole : uint8_t { None, Record, Replay };
+        CacheRole cacheRole = CacheRole::None;
+        uint32_t cacheGeneration = 0;
+    };
+    
+    // The last held grain a voice rendered, windowed and phase aligned but not
+    // panned, per source channel. Filled by the grain that first renders it.
+    struct GrainCache {
+        std::array<DSPUtils::FloatBlock, MAX_OUTPUT_CHANNELS> channels;
+        uint32_t generation = 0;
+        int numRendered = 0;
+        int length = 0;  // 0 while empty
+        
+        // What the cached grain was rendered from
+        double startPosition = 0.0;
+        double pitchRatio = 0.0;
+        double step = 0.0;
+        double grainLength = 0.0;
+        const DSPUtils::WindowTable* window = nullptr;
+        int interpolationPoints = 0;
+        int numSourceChannels = 0;
+        uint32_t sourceVersion = 0;
+        
+        void allocate(size_t maxLength, DSPArena& arena) {
+            for (auto& channel : channels)
+                channel.allocate(maxLength, &arena);
+            length = numRendered = 0;
+        }
+        
+        // Grains already playing or recording stop using it
+        void invalidate() {
+            ++generation;
+            length = numRendered = 0;
+        }
+        
+        // A recording cut short would never finish, so drop it
+        void abandonIncomplete() {
+            if (numRendered < length)
+                invalidate();
+        }
+    };
+
+    // Fixed-capacity grain storage carved from the arena, so spawning a grain
+    // never allocates; a voice that is already full skips the new grain
+    class GrainList {
+    public:
+        void allocate(DSPArena& arena) {
+            grains = arena.allocate<Grain>(MAX_GRAINS_PER_VOICE);
+            count = 0;
+        }
+        
+        Grain* begin() { return grains; }
+        Grain* end() { return grains + count; }
+        bool empty() const { return count == 0; }
+        int size() const { return count; }
+        bool full() const { return grains == nullptr || count == MAX_GRAINS_PER_VOICE; }
+        Grain& back() { return grains[count - 1]; }
+        
+        void push_back(const Grain& grain) {
+            if (!full())
+                new (grains + count++) Grain(grain);
+        }
+        
+        void clear() { count = 0; }
+        
+        void removeInactive() {
+            count = static_cast<int>(std::remove_if(begin(), end(), [](const Grain& g) { return !g.isActive; }) - begin());
+        }
+        
+    private:
+        Grain* grains = nullptr;
+        int count = 0;
     };
 
-    struct Voice {
+    // Cache-line aligned so neighbouring voices never share a line
+    struct alignas(DSPArena::ALIGNMENT) Voice {
         bool isActive = false;
         double position = 0.0;
         double pitchRatio = 1.0;
         float velocity = 0.0f;
         int midiNote = -1;
         float lastOutputSample = 0.0f;
+        juce::Random grainRandom;  // Seeded per note, so grain placement doesn't depend on render order
+        DSPUtils::LaneRandom cloudRandom;  // The same, for cloud jitter
+        double nextPooledGrain = 0.0;  // Samples into the next block
+        bool releasePooledGrains = false;  // Set by reset; the next pooled block frees the grains of a voice still inactive
         
-        std::vector<Grain> grains;
+        GrainList grains;
+        GrainCache grainCache;
+        PhaseVocoder phaseVocoder;
         float grainDuration = 0.1f;
         float grainOverlap = 0.5f;
         
-        // DSP processing chain
+        // DSP processing chain, one per output channel after the grains are panned
         DSPUtils::Resampler resampler;
-        DSPUtils::ButterworthFilter antiAliasFilter;
-        DSPUtils::DCBlocker dcBlocker;
-        DSPUtils::SoftClipper softClipper;
+        
+        struct ChannelChain {
+            DSPUtils::ButterworthFilter antiAliasFilter;
+            DSPUtils::DCBlocker dcBlocker;
+            DSPUtils::SoftClipper softClipper;
+            
+            void copyStateFrom(const ChannelChain& other) {
+                antiAliasFilter = other.antiAliasFilter;
+                dcBlocker = other.dcBlocker;
+                softClipper.copyStateFrom(other.softClipper);
+            }
+        };
+        std::array<ChannelChain, MAX_OUTPUT_CHANNELS> chains;
+        bool chainsLinked = true;  // Every chain holds the first one's state, so identical channels can share it
         
         struct Envelope {
             float attackTime = 0.01f;
@@ -94,20 +362,37 @@ private:
             };
             
             State state = State::Idle;
+            EnvelopeCurve curve = EnvelopeCurve::Linear;
             float currentLevel = 0.0f;
-            float currentTime = 0.0f;
+            
+            // Current segment, computed once when the state changes
+            int samplesRemaining = 0;
+            float targetLevel = 0.0f;
+            float increment = 0.0f;        // Linear: level step per sample
+            float logDecayPerSample = 0.0f; // Exponential: log of the per-sample distance ratio
             
             void setParameters(float attack, float decay, float sustain, float release, float sr);
-            float process();
-            void noteOn();
-            void noteOff();
+            void process(float* gains, int numSamples);
+            void noteOn();   // Attack from the current level, so retriggers don't click
+            void noteOff();  // Release from the current level
+            void reset();
+            bool isIdle() const { return state == State::Idle; }
+            
+        private:
+            void enterState(State newState);
         } envelope;
         
-        void prepare(double sampleRate) {
+        void prepare(double sampleRate, int maxBlockSize, DSPArena& arena) {
             resampler.prepare(sampleRate);
-            antiAliasFilter.prepare(sampleRate);
-            dcBlocker.reset();
-            softClipper.prepare(sampleRate);
+            grains.allocate(arena);
+            grainCache.allocate(static_cast<size_t>(std::ceil(MAX_GRAIN_DURATION * sampleRate)) + 1, arena);
+            phaseVocoder.allocate(arena);
+            for (auto& chain : chains) {
+                chain.antiAliasFilter.prepare(sampleRate);
+                chain.dcBlocker.reset();
+                chain.softClipper.prepare(sampleRate, maxBlockSize, &arena);
+            }
+            chainsLinked = true;
             envelope.sampleRate = static_cast<float>(sampleRate);
         }
         
@@ -116,11 +401,20 @@ private:
             position = 0.0;
             lastOutputSample = 0.0f;
             grains.clear();
-            dcBlocker.reset();
+            grainCache.abandonIncomplete();
+            phaseVocoder.reset();
+            nextPooledGrain = 0.0;
+            releasePooledGrains = true;
+            for (auto& chain : chains) {
+                chain.antiAliasFilter.reset();
+                chain.dcBlocker.reset();
+                chain.softClipper.reset();
+            }
+            chainsLinked = true;
+            envelope.reset();
         }
     };
 
-    static constexpr int MAX_VOICES = 16;
     std::array<Voice, MAX_VOICES> voices;
     
     juce::AudioFormatManager formatManager;
@@ -128,6 +422,41 @@ private:
     juce::AudioBuffer<float> fileBuffer;
     juce::AudioBuffer<float> tempBuffer;
     
+    // One voice's pre-envelope signal and envelope gains for the block. A
+    // single set is shared unless voices render in parallel, which needs one
+    // set per voice.
+    struct VoiceScratch {
+        std::array<DSPUtils::FloatBlock, MAX_OUTPUT_CHANNELS> channels;
+        DSPUtils::FloatBlock gains;
+        PhaseVocoder::Workspace vocoder;
+    };
+    std::array<VoiceScratch, MAX_VOICES> voiceScratch;
+    int numVoiceScratchSets = 0;
+    juce::ThreadPool* voiceThreadPool = nullptr;
+    
+    // Every per-block buffer above and below (scratch, grains, filter and
+    // limiter state) is carved from this one block in prepareToPlay. Sample
+    // data and window tables stay outside, as they are built off that path.
+    DSPArena arena;
+    bool useHugePages = false;
+    const DSPKernels::KernelTable* kernels = &DSPKernels::getTable(DSPKernels::ISA::Generic);
+    
+    // Live input, recorded whether or not the grains are reading it
+    LiveCapture liveCapture;
+    std::atomic<bool> liveInput{ false };
+    std::atomic<bool> liveFrozen{ false };
+    std::atomic<float> liveHorizon{ 2.0f };
+    bool liveInputActive = false;  // Audio thread's view, updated in captureInput
+    int liveWindowLength = 0;
+    
+    // Cloud, PSOLA and concatenative mode's grains, for all voices, and four random values per cloud grain being started
+    GrainCloud grainCloud;
+    DSPUtils::FloatBlock cloudJitter;
+    float cloudDensity = 200.0f;
+    float positionJitter = 0.05f;
+    float pitchJitter = 0.0f;
+    float durationJitter = 0.0f;
+    
     double currentSampleRate = 44100.0;
     double fileSampleRate = 44100.0;
     double sampleRateRatio = 1.0;
@@ -137,19 +466,93 @@ private:
     double holdPosition = 0.0;
     bool isEnabled = true;
     PlaybackMode playbackMode = PlaybackMode::Polyphonic;  // Replace triggerMode
+    SynthesisMode synthesisMode = SynthesisMode::Granular;
+    SynthesisMode renderedSynthesisMode = SynthesisMode::Granular;  // Audio thread's view
     std::atomic<float> currentLevel{0.0f};
     
     // Output processing
-    DSPUtils::PeakLimiter outputLimiter;
+    DSPUtils::LookaheadLimiter outputLimiter;
+    
+    // Grain windows, one table per shape, built in prepareToPlay
+    std::array<DSPUtils::WindowTable, static_cast<size_t>(DSPUtils::GrainWindow::Shape::NumShapes)> windowTables;
+    DSPUtils::GrainWindow::Shape windowShape = DSPUtils::GrainWindow::Shape::Classic;
+    EnvelopeCurve envelopeCurve = EnvelopeCurve::Linear;
+    float pan = 0.0f;
+    float spread = 0.0f;
+    juce::Random grainRandom;
     
     float defaultGrainDuration = 0.1f;  // Default grain duration in seconds
+    uint32_t sourceVersion = 0;  // Bumped on every load or live window move, so stale caches are dropped
+    uint32_t sampleVersion = 0;  // Bumped on every load only; keys the sample's indexes
+    SpectralIndex spectralIndex;
+    bool spectralIndexEnabled = false;
+    OnsetIndex onsetIndex;
+    PitchMarkIndex pitchMarks;  // Built while PSOLA is selected
+    DescriptorIndex descriptorIndex;  // Built while concatenative mode is selected
+    DescriptorIndex::Point descriptorTargets{ 0.5f, 0.5f, 0.5f, 0.5f, 0.5f };
+    DescriptorIndex::Point descriptorWeights{ 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };  // Pitch only
+    GrainSnap grainSnap = GrainSnap::Off;
+    float snapRange = 0.02f;  // Seconds
+    float snapStrength = 1.0f;
+    int oversamplingFactor = 2;
+    RenderQuality renderQuality;
     
+    void layoutRealtimeState(double sampleRate, int samplesPerBlock);
+    void buildSynthesisModeIndex();  // PSOLA's pitch marks or concatenative mode's descriptors, for the loaded sample
     void startVoice(int midiNoteNumber, float velocity);
+    void triggerVoice(Voice& voice, int midiNoteNumber, float velocity);
     void stopVoice(int midiNoteNumber);
-    void updateGrains(Voice& voice);
+    // Per-block inputs shared by every voice's render kernel
+    struct RenderContext {
+        const DSPUtils::WindowTable* window = nullptr;
+        const float* sourceChannels[MAX_OUTPUT_CHANNELS] = {};
+        int numSourceChannels = 1;
+        int sourceLength = 0;
+        uint32_t sourceVersion = 0;
+        float* mix[MAX_OUTPUT_CHANNELS] = {};  // Null leaves each voice in its scratch channels
+    };
+    
+    // Renders one voice into the mix and returns its peak level. Each flag
+    // combination is its own instantiation, picked once per voice per block.
+    using RenderKernel = float (SamplePlayer::*)(Voice&, VoiceScratch&, const RenderContext&, int);
+    static RenderKernel selectRenderKernel(bool highPrecision, bool holdMode, bool looping, bool stereoSource, bool pitchUp);
+    template <size_t... Flags>
+    static constexpr std::array<RenderKernel, sizeof...(Flags)> makeRenderKernels(std::index_sequence<Flags...>);
+    float renderVoiceWithKernel(Voice& voice, VoiceScratch& scratch, const RenderContext& context, int numSamples);
+    float renderVoicesInParallel(Voice* const* activeVoices, int numActive, const RenderContext& context, int numSamples);
+    
+    template <bool HighPrecision, bool HoldMode, bool Looping, bool StereoSource, bool PitchUp>
+    float renderVoice(Voice& voice, VoiceScratch& scratch, const RenderContext& context, int numSamples);
+    
+    float renderPhaseVocoderVoice(Voice& voice, VoiceScratch& scratch, const RenderContext& context, int numSamples);
+    float renderPooledVoice(Voice& voice, VoiceScratch& scratch, const RenderContext& context, int numSamples);
+    
+    // Starts the block's pooled grains for every voice, before any renders
+    static bool usesGrainPool(SynthesisMode mode) { return mode == SynthesisMode::Cloud || mode == SynthesisMode::Psola || mode == SynthesisMode::Concatenative; }
+    void schedulePooledGrains(const RenderContext& context, int numSamples);
+    void spawnCloudGrains(Voice& voice, int voiceIndex, const RenderContext& context, int numSamples, int& budget);
+    void spawnPsolaGrains(Voice& voice, int voiceIndex, const RenderContext& context, int numSamples, int& budget);
+    void spawnConcatenativeGrains(Voice& voice, int voiceIndex, const RenderContext& context, int numSamples, int& budget);
+    void advancePooledVoice(Voice& voice, double step, int sourceLength, int numSamples);
+    
+    // Envelope, filters, clipper and mix, shared by every synthesis mode
+    template <bool PitchUp>
+    float processVoiceChain(Voice& voice, VoiceScratch& scratch, const RenderContext& context, int numSamples);
+    
+    template <bool HoldMode, bool Looping>
+    void updateGrains(Voice& voice, bool grainFinished, const RenderContext& context);
+    void assignGrainCache(Voice& voice, Grain& grain, const RenderContext& context);
+    double snapGrainStart(double position) const;
+    static std::array<float, MAX_OUTPUT_CHANNELS> getPanGains(float panPosition);  // Constant power, unity at the centre
+    int getSourceLength() const { return liveInputActive ? liveWindowLength : fileBuffer.getNumSamples(); }
+    void restartVoicesOnNewSource(int previousLength);
+    void shiftLivePositions(double grainShift, double holdScale);
+    void normaliseSample();
     void applyFades();
-    int findFreeVoice() const;
+    int getRequestedOversamplingFactor() const { return std::max(oversamplingFactor, renderQuality.minOversamplingFactor); }
+    int findFreeVoice() const;  // -1 once renderQuality.maxVoices are sounding
     void stealVoice();
+    void releaseVoicesOverLimit();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SamplePlayer)
 }; 
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "SessionRecorder.h"
+#include <algorithm>
+#include <cstring>
+
+// Records are stored in native (little-endian) byte order, packed without
+// padding: a one byte type followed by the fields listed in SessionLog.
+
+SessionRecorder::SessionRecorder() : juce::Thread("Session Recorder")
+{
+    ring.resize(RING_SIZE);
+}
+
+SessionRecorder::~SessionRecorder()
+{
+    stop();
+}
+
+bool SessionRecorder::start(const juce::File& logFile, const juce::String& samplePath)
+{
+    stop();
+
+    logFile.deleteFile();
+    stream = std::make_unique<juce::FileOutputStream>(logFile);
+    if (stream->failedToOpen())
+    {
+        stream.reset();
+        return false;
+    }
+
+    stream->writeInt(static_cast<int>(SessionLog::magic));
+    stream->writeInt(static_cast<int>(SessionLog::version));
+    stream->writeString(samplePath);
+
+    droppedRecords.store(0);
+    recording.store(true);
+    startThread();
+    return true;
+}
+
+void SessionRecorder::stop()
+{
+    if (!recording.exchange(false))
+        return;
+
+    // Pushes check the flag once they've counted themselves in, so after
+    // this none is writing and none will start until the next start()
+    while (activePushes.load() > 0)
+        juce::Thread::yield();
+
+    stopThread(1000);
+    drain();
+    stream->flush();
+    stream.reset();
+
+    fifo.reset();
+    samplePathPending.store(false);
+}
+
+void SessionRecorder::recordSample(const juce::String& samplePath)
+{
+    if (!recording.load())
+        return;
+
+    const juce::SpinLock::ScopedLockType lock(samplePathLock);
+    const auto utf8 = samplePath.toUTF8();
+    pendingSamplePathBytes = static_cast<int>(std::min(utf8.sizeInBytes() - 1, pendingSamplePath.size()));
+    std::memcpy(pendingSamplePath.data(), utf8.getAddress(), static_cast<size_t>(pendingSamplePathBytes));
+    samplePathPending.store(true);
+}
+
+void SessionRecorder::pushPendingSample()
+{
+    if (!samplePathPending.load())
+        return;
+
+    // A load in progress is picked up on the next block instead
+    const juce::SpinLock::ScopedTryLockType lock(samplePathLock);
+    if (!lock.isLocked())
+        return;
+
+    juce::uint8 record[1 + sizeof(juce::uint16) + MAX_PATH_BYTES];
+    const auto numBytes = static_cast<juce::uint16>(pendingSamplePathBytes);
+    record[0] = static_cast<juce::uint8>(SessionLog::RecordType::Sample);
+    std::memcpy(record + 1, &numBytes, sizeof(juce::uint16));
+    std::memcpy(record + 1 + sizeof(juce::uint16), pendingSamplePath.data(), numBytes);
+    push(record, 1 + static_cast<int>(sizeof(juce::uint16)) + numBytes);
+    samplePathPending.store(false);
+}
+
+void SessionRecorder::recordPrepare(double sampleRate, int maxBlockSize)
+{
+    juce::uint8 record[1 + sizeof(double) + sizeof(juce::int32)];
+    const juce::int32 blockSize = maxBlockSize;
+    record[0] = static_cast<juce::uint8>(SessionLog::RecordType::Prepare);
+    std::memcpy(record + 1, &sampleRate, sizeof(double));
+    std::memcpy(record + 1 + sizeof(double), &blockSize, sizeof(juce::int32));
+    push(record, sizeof(record));
+}
+
+void SessionRecorder::recordBlock(int numSamples)
+{
+    pushPendingSample();
+
+    juce::uint8 record[1 + sizeof(juce::int32)];
+    const juce::int32 size = numSamples;
+    record[0] = static_cast<juce::uint8>(SessionLog::RecordType::Block);
+    std::memcpy(record + 1, &size, sizeof(juce::int32));
+    push(record, sizeof(record));
+}
+
+void SessionRecorder::recordMidi(int samplePosition, const juce::uint8* data, int numBytes)
+{
+    // Long sysex dumps don't affect the engine, so they are not worth the ring space
+    if (numBytes <= 0 || numBytes > 255)
+        return;
+
+    juce::uint8 record[1 + sizeof(juce::int32) + 1 + 255];
+    const juce::int32 position = samplePosition;
+    record[0] = static_cast<juce::uint8>(SessionLog::RecordType::Midi);
+    std::memcpy(record + 1, &position, sizeof(juce::int32));
+    record[1 + sizeof(juce::int32)] = static_cast<juce::uint8>(numBytes);
+    std::memcpy(record + 2 + sizeof(juce::int32), data, static_cast<size_t>(numBytes));
+    push(record, 2 + static_cast<int>(sizeof(juce::int32)) + numBytes);
+}
+
+void SessionRecorder::recordParameter(SessionLog::ParameterId parameter, float value)
+{
+    juce::uint8 record[2 + sizeof(float)];
+    record[0] = static_cast<juce::uint8>(SessionLog::RecordType::Parameter);
+    record[1] = static_cast<juce::uint8>(parameter);
+    std::memcpy(record + 2, &value, sizeof(float));
+    push(record, sizeof(record));
+}
+
+void SessionRecorder::push(const void* record, int numBytes)
+{
+    activePushes.fetch_add(1);
+    if (!recording.load())
+    {
+        activePushes.fetch_sub(1);
+        return;
+    }
+
+    if (fifo.getFreeSpace() < numBytes)
+    {
+        droppedRecords.fetch_add(1);
+        activePushes.fetch_sub(1);
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(numBytes, start1, size1, start2, size2);
+
+    const auto* bytes = static_cast<const juce::uint8*>(record);
+    std::memcpy(ring.data() + start1, bytes, static_cast<size_t>(size1));
+    if (size2 > 0)
+        std::memcpy(ring.data() + start2, bytes + size1, static_cast<size_t>(size2));
+
+    fifo.finishedWrite(size1 + size2);
+    activePushes.fetch_sub(1);
+}
+
+void SessionRecorder::drain()
+{
+    const int numReady = fifo.getNumReady();
+    if (numReady == 0 || stream == nullptr)
+        return;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(numReady, start1, size1, start2, size2);
+
+    stream->write(ring.data() + start1, static_cast<size_t>(size1));
+    if (size2 > 0)
+        stream->write(ring.data() + start2, static_cast<size_t>(size2));
+
+    fifo.finishedRead(size1 + size2);
+}
+
+void SessionRecorder::run()
+{
+    while (!threadShouldExit())
+    {
+        drain();
+        wait(20);
+    }
+}
+
+//==============================================================================
+bool SessionReader::open(const juce::File& logFile)
+{
+    stream = std::make_unique<juce::FileInputStream>(logFile);
+    if (stream->failedToOpen())
+        return false;
+
+    failed = false;
+    if (static_cast<juce::uint32>(stream->readInt()) != SessionLog::magic)
+        return false;
+
+    const auto logVersion = static_cast<juce::uint32>(stream->readInt());
+    if (logVersion < 1 || logVersion > SessionLog::version)
+        return false;
+
+    samplePath = stream->readString();
+    return true;
+}
+
+bool SessionReader::readBytes(void* destination, int numBytes)
+{
+    if (stream->read(destination, numBytes) == numBytes)
+        return true;
+
+    failed = true;
+    return false;
+}
+
+bool SessionReader::readNext(SessionLog::Record& record)
+{
+    if (stream == nullptr || failed || stream->isExhausted())
+        return false;
+
+    juce::uint8 type = 0;
+    if (!readBytes(&type, 1))
+        return false;
+
+    // Each field is read in full or the record fails, so a log cut short
+    // mid-record is reported rather than replayed with made-up values
+    record.type = static_cast<SessionLog::RecordType>(type);
+    switch (record.type)
+    {
+        case SessionLog::RecordType::Prepare:
+            return readBytes(&record.sampleRate, sizeof(double))
+                && readBytes(&record.numSamples, sizeof(juce::int32));
+
+        case SessionLog::RecordType::Block:
+            return readBytes(&record.numSamples, sizeof(juce::int32));
+
+        case SessionLog::RecordType::Midi:
+        {
+            juce::uint8 size = 0;
+            if (!readBytes(&record.samplePosition, sizeof(juce::int32)) || !readBytes(&size, 1))
+                return false;
+            record.midiSize = size;
+            return readBytes(record.midiData, record.midiSize);
+        }
+
+        case SessionLog::RecordType::Parameter:
+        {
+            juce::uint8 parameter = 0;
+            if (!readBytes(&parameter, 1) || !readBytes(&record.value, sizeof(float)))
+                return false;
+            if (parameter >= static_cast<juce::uint8>(SessionLog::ParameterId::NumParameters))
+                break;
+            record.parameter = static_cast<SessionLog::ParameterId>(parameter);
+            return true;
+        }
+
+        case SessionLog::RecordType::Sample:
+        {
+            juce::uint16 numBytes = 0;
+            if (!readBytes(&numBytes, sizeof(juce::uint16)))
+                return false;
+            std::vector<char> path(numBytes);
+            if (!readBytes(path.data(), numBytes))
+                return false;
+            record.samplePath = juce::String::fromUTF8(path.data(), numBytes);
+            return true;
+        }
+    }
+
+    // Unknown record type, the rest of the log can't be trusted
+    failed = true;
+    return false;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <vector>
+
+// Compact binary log of everything that drives the audio thread: prepare
+// calls, block sizes, sample loads, MIDI and parameter changes. Written off-thread so a
+// user's session can be replayed headless to reproduce CPU spikes.
+namespace SessionLog
+{
+    static constexpr juce::uint32 magic = 0x4c515053;  // "SPQL"
+    static constexpr juce::uint32 version = 2;  // 2 added Sample records; version 1 logs still read
+
+    enum class RecordType : juce::uint8
+    {
+        Prepare = 1,    // double sampleRate, int32 maxBlockSize
+        Block = 2,      // int32 numSamples, renders everything queued since the last block
+        Midi = 3,       // int32 samplePosition, uint8 numBytes, raw bytes
+        Parameter = 4,  // uint8 ParameterId, float value
+        Sample = 5      // uint16 numBytes, UTF-8 path of the sample loaded from the next block on
+    };
+
+    enum class ParameterId : juce::uint8
+    {
+        PlaybackSpeed = 0,
+        Looping,
+        HoldMode,
+        HoldPosition,
+        GrainDuration,
+        PlaybackMode,
+        WindowShape,
+        OversamplingFactor,
+        Pan,
+        Spread,
+        SynthesisMode,
+        CloudDensity,
+        PositionJitter,
+        PitchJitter,
+        DurationJitter,
+        GrainSnap,
+        SnapRange,
+        SnapStrength,
+        TargetLoudness,
+        TargetBrightness,
+        TargetNoisiness,
+        TargetZeroCrossingRate,
+        LoudnessWeight,
+        BrightnessWeight,
+        NoisinessWeight,
+        PitchWeight,
+        ZeroCrossingRateWeight,
+        NumParameters
+    };
+
+    // Stable names for the parameters, e.g. the attributes of a render preset
+    inline const char* getParameterName(ParameterId parameter)
+    {
+        switch (parameter)
+        {
+            case ParameterId::PlaybackSpeed:      return "PlaybackSpeed";
+            case ParameterId::Looping:            return "Looping";
+            case ParameterId::HoldMode:           return "HoldMode";
+            case ParameterId::HoldPosition:       return "HoldPosition";
+            case ParameterId::GrainDuration:      return "GrainDuration";
+            case ParameterId::PlaybackMode:       return "PlaybackMode";
+            case ParameterId::WindowShape:        return "WindowShape";
+            case ParameterId::OversamplingFactor: return "OversamplingFactor";
+            case ParameterId::Pan:                return "Pan";
+            case ParameterId::Spread:             return "Spread";
+            case ParameterId::SynthesisMode:      return "SynthesisMode";
+            case ParameterId::CloudDensity:       return "CloudDensity";
+            case ParameterId::PositionJitter:     return "PositionJitter";
+            case ParameterId::PitchJitter:        return "PitchJitter";
+            case ParameterId::DurationJitter:     return "DurationJitter";
+            case ParameterId::GrainSnap:          return "GrainSnap";
+            case ParameterId::SnapRange:          return "SnapRange";
+            case ParameterId::SnapStrength:       return "SnapStrength";
+            case ParameterId::TargetLoudness:     return "TargetLoudness";
+            case ParameterId::TargetBrightness:   return "TargetBrightness";
+            case ParameterId::TargetNoisiness:    return "TargetNoisiness";
+            case ParameterId::TargetZeroCrossingRate: return "TargetZeroCrossingRate";
+            case ParameterId::LoudnessWeight:     return "LoudnessWeight";
+            case ParameterId::BrightnessWeight:   return "BrightnessWeight";
+            case ParameterId::NoisinessWeight:    return "NoisinessWeight";
+            case ParameterId::PitchWeight:        return "PitchWeight";
+            case ParameterId::ZeroCrossingRateWeight: return "ZeroCrossingRateWeight";
+            case ParameterId::NumParameters:      break;
+        }
+
+        return "";
+    }
+
+    struct Record
+    {
+        RecordType type = RecordType::Block;
+        double sampleRate = 0.0;
+        int numSamples = 0;
+        int samplePosition = 0;
+        juce::uint8 midiData[255] = {};
+        int midiSize = 0;
+        ParameterId parameter = ParameterId::PlaybackSpeed;
+        float value = 0.0f;
+        juce::String samplePath;
+    };
+}
+
+// Records from the audio thread into a lock-free ring; a background thread
+// drains the ring to disk. Records that don't fit are dropped and counted
+// rather than blocking the audio thread.
+class SessionRecorder : private juce::Thread
+{
+public:
+    SessionRecorder();
+    ~SessionRecorder() override;
+
+    // Message thread
+    bool start(const juce::File& logFile, const juce::String& samplePath);
+    void stop();
+    bool isRecording() const { return recording.load(); }
+    int getNumDroppedRecords() const { return droppedRecords.load(); }
+
+    // Message thread, after every sample load. Logged by the audio thread
+    // ahead of its next block, so the ring keeps a single writer.
+    void recordSample(const juce::String& samplePath);
+
+    // Audio thread
+    void recordPrepare(double sampleRate, int maxBlockSize);
+    void recordBlock(int numSamples);
+    void recordMidi(int samplePosition, const juce::uint8* data, int numBytes);
+    void recordParameter(SessionLog::ParameterId parameter, float value);
+
+private:
+    void run() override;
+    void push(const void* record, int numBytes);
+    void pushPendingSample();
+    void drain();
+
+    static constexpr int RING_SIZE = 1 << 18;
+    static constexpr int MAX_PATH_BYTES = 4096;
+
+    juce::AbstractFifo fifo{ RING_SIZE };
+    std::vector<juce::uint8> ring;
+    std::unique_ptr<juce::FileOutputStream> stream;
+    std::atomic<bool> recording{ false };
+    std::atomic<int> activePushes{ 0 };  // Audio thread pushes under way, which stop() waits out
+    std::atomic<int> droppedRecords{ 0 };
+
+    // The last loaded sample's path, handed from the message thread
+    juce::SpinLock samplePathLock;
+    std::array<char, MAX_PATH_BYTES> pendingSamplePath{};
+    int pendingSamplePathBytes = 0;
+    std::atomic<bool> samplePathPending{ false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SessionRecorder)
+};
+
+// Reads a log written by SessionRecorder, one record at a time
+class SessionReader
+{
+public:
+    bool open(const juce::File& logFile);
+    const juce::String& getSamplePath() const { return samplePath; }
+
+    // False at the end of the log, or at a truncated or unknown record, after
+    // which hasFailed() tells the two apart
+    bool readNext(SessionLog::Record& record);
+    bool hasFailed() const { return failed; }
+
+private:
+    bool readBytes(void* destination, int numBytes);
+
+    std::unique_ptr<juce::FileInputStream> stream;
+    juce::String samplePath;
+    bool failed = false;
+};
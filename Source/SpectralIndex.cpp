@@ -0,0 +1,92 @@
+#include "SpectralIndex.h"
+#include <cmath>
+
+SpectralIndex::SpectralIndex() : BackgroundIndex("Spectral Index")
+{
+}
+
+SpectralIndex::~SpectralIndex()
+{
+    cancel();
+}
+
+void SpectralIndex::buildIndex(const juce::AudioBuffer<float>& source, double, uint32_t sourceVersion)
+{
+    const int numChannels = std::min(source.getNumChannels(), PhaseVocoder::MAX_CHANNELS);
+    const int length = source.getNumSamples();
+    if (numChannels == 0 || length == 0)
+        return;
+
+    // A workspace of its own, so the analysis is exactly the vocoder's
+    DSPArena arena;
+    PhaseVocoder::Workspace workspace;
+    arena.beginMeasure();
+    workspace.allocate(arena);
+    arena.commit(false);
+    workspace.allocate(arena);
+
+    auto built = std::make_unique<Frames>();
+    built->sourceVersion = sourceVersion;
+    built->numChannels = numChannels;
+    built->numFrames = length / PhaseVocoder::HOP_SIZE + 2;
+    built->magnitudes.resize(built->getOffset(built->numFrames, 0));
+    built->phases.resize(built->magnitudes.size());
+
+    PhaseVocoder::Source vocoderSource;
+    vocoderSource.channels = source.getArrayOfReadPointers();
+    vocoderSource.numChannels = numChannels;
+    vocoderSource.length = length;
+
+    float* magnitudes = workspace.magnitudes.data();
+    float* phases = workspace.phases.data();
+
+    for (int frame = 0; frame < built->numFrames; ++frame)
+    {
+        if (threadShouldExit())
+            return;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            PhaseVocoder::analyseFrame(vocoderSource, channel, (frame - 1) * PhaseVocoder::HOP_SIZE, workspace, magnitudes, phases);
+
+            const size_t offset = built->getOffset(frame, channel);
+            for (int bin = 0; bin < PhaseVocoder::NUM_BINS; ++bin)
+            {
+                const float steps = magnitudes[bin] > 0.0f ? (std::log2(magnitudes[bin]) - MIN_LOG2_MAGNITUDE) * STEPS_PER_OCTAVE : 0.0f;
+                built->magnitudes[offset + bin] = static_cast<uint16_t>(juce::jlimit(0.0f, 65535.0f, std::round(steps)));
+                built->phases[offset + bin] = static_cast<int16_t>(juce::jlimit(-32768.0f, 32767.0f, std::round(phases[bin] * (32768.0f / juce::MathConstants<float>::pi))));
+            }
+        }
+    }
+
+    sizeInBytes = built->magnitudes.size() * sizeof(uint16_t) + built->phases.size() * sizeof(int16_t);
+    frames.publish(std::move(built));
+}
+
+void SpectralIndex::decodeFrame(const Frames& index, int frame, int channel, float* magnitudes, float* phases) const
+{
+    const size_t offset = index.getOffset(frame, channel);
+
+    for (int bin = 0; bin < PhaseVocoder::NUM_BINS; ++bin)
+    {
+        const uint16_t steps = index.magnitudes[offset + bin];
+        magnitudes[bin] = steps == 0 ? 0.0f : std::exp2(steps * (1.0f / STEPS_PER_OCTAVE) + MIN_LOG2_MAGNITUDE);
+        phases[bin] = index.phases[offset + bin] * (juce::MathConstants<float>::pi / 32768.0f);
+    }
+}
+
+bool SpectralIndex::decode(uint32_t sourceVersion, int channel, double position, PhaseVocoder::Workspace& workspace) const
+{
+    const auto* index = frames.get();
+    if (index == nullptr || index->sourceVersion != sourceVersion || channel >= index->numChannels)
+        return false;
+
+    const int frame = juce::jlimit(1, index->numFrames - 1, juce::roundToInt(position / PhaseVocoder::HOP_SIZE) + 1);
+
+    // Only the phases of the earlier frame are needed, so its magnitudes go
+    // where the later frame's will overwrite them
+    decodeFrame(*index, frame - 1, channel, workspace.magnitudes.data(), workspace.previousPhases.data());
+    decodeFrame(*index, frame, channel, workspace.magnitudes.data(), workspace.phases.data());
+    PhaseVocoder::measureFrequencies(workspace.previousPhases.data(), workspace.phases.data(), workspace.frequencies.data());
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "BackgroundIndex.h"
+#include "PhaseVocoder.h"
+#include <atomic>
+#include <vector>
+
+// Magnitude and phase STFT frames of the loaded sample, one per phase vocoder
+// hop, built on a background thread after each load. A held phase vocoder
+// voice resynthesises from the frame nearest its position instead of
+// analysing the sample, so a freeze costs one inverse FFT per hop.
+//
+// Magnitudes are kept as 16-bit log values (1/1024 octave steps) and phases
+// as 16-bit fractions of a turn, half the size of float spectra.
+class SpectralIndex : public BackgroundIndex
+{
+public:
+    SpectralIndex();
+    ~SpectralIndex() override;
+
+    // Audio thread, between updates. Fills the workspace's magnitudes, phases
+    // and frequencies from the frame nearest position. Returns false, leaving
+    // the analysis to the caller, when there is no index of that source version yet.
+    bool decode(uint32_t sourceVersion, int channel, double position, PhaseVocoder::Workspace& workspace) const;
+
+    // Of the newest finished index, from any thread
+    size_t getSizeInBytes() const { return sizeInBytes; }
+
+private:
+    void buildIndex(const juce::AudioBuffer<float>& source, double sampleRate, uint32_t sourceVersion) override;
+    void pickUpIndex() override { frames.pickUp(); }
+
+    // Frame f starts (f - 1) hops into the sample, so every frame has the one
+    // a hop before it for measuring frequencies
+    struct Frames
+    {
+        uint32_t sourceVersion = 0;
+        int numChannels = 0;
+        int numFrames = 0;
+        std::vector<uint16_t> magnitudes;  // [frame][channel][bin]
+        std::vector<int16_t> phases;
+
+        size_t getOffset(int frame, int channel) const
+        {
+            return (static_cast<size_t>(frame) * numChannels + channel) * PhaseVocoder::NUM_BINS;
+        }
+    };
+
+    static constexpr float MIN_LOG2_MAGNITUDE = -24.0f;  // Stored as 0, which decodes to silence
+    static constexpr float STEPS_PER_OCTAVE = 1024.0f;
+
+    void decodeFrame(const Frames& index, int frame, int channel, float* magnitudes, float* phases) const;
+
+    IndexHandoff<Frames> frames;
+    std::atomic<size_t> sizeInBytes{ 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectralIndex)
+};
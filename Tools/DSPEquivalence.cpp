@@ -0,0 +1,540 @@
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include "DSPUtils.h"
+#include "ReferenceDSP.h"
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <vector>
+
+// Numerical equivalence check for the DSP kernels.
+//
+// Renders every kernel through the frozen scalar implementation in
+// ReferenceDSP.h and through the current DSPUtils path, over a corpus of
+// synthetic signals plus any audio files passed with --corpus, and compares
+// them against a per-kernel tolerance (max absolute error and SNR). Exits
+// non-zero when any kernel is out of tolerance.
+//
+// Usage: speculator-dsp-check [--corpus dir] [--rate Hz] [--verbose]
+//                             [--isa generic|avx2|avx512]
+
+namespace
+{
+    using Signal = std::vector<float>;
+
+    struct TestSignal
+    {
+        juce::String name;
+        Signal samples;
+    };
+
+    struct Tolerance
+    {
+        double maxAbsError;
+        double minSnrDb;
+    };
+
+    struct KernelCheck
+    {
+        const char* name;
+        Tolerance tolerance;
+
+        // Renders the reference and the path under test for one input signal
+        std::function<void(const Signal& input, double sampleRate, Signal& reference, Signal& tested)> render;
+
+        // Restricts the check to some signals, e.g. band-limited ones; empty means all
+        std::function<bool(const juce::String& signalName)> appliesTo = {};
+    };
+
+    // Block size for kernels that have a block API
+    constexpr size_t blockSize = 256;
+
+    // The --isa table, handed to every processor under test
+    const DSPKernels::KernelTable* testedKernels = &DSPKernels::getTable(DSPKernels::ISA::Generic);
+
+    // Runs a block processor over a whole signal, blockSize samples at a time
+    template <typename Processor>
+    void processInBlocks(Signal& samples, Processor& processor)
+    {
+        for (size_t start = 0; start < samples.size(); start += blockSize)
+            processor.process(samples.data() + start, static_cast<int>(std::min(blockSize, samples.size() - start)));
+    }
+
+    struct Comparison
+    {
+        double maxAbsError = 0.0;
+        double snrDb = std::numeric_limits<double>::infinity();
+    };
+
+    Comparison compare(const Signal& reference, const Signal& tested)
+    {
+        Comparison result;
+        if (tested.size() != reference.size())
+        {
+            result.maxAbsError = std::numeric_limits<double>::infinity();
+            result.snrDb = -std::numeric_limits<double>::infinity();
+            return result;
+        }
+
+        double signalEnergy = 0.0, errorEnergy = 0.0;
+        for (size_t i = 0; i < reference.size(); ++i)
+        {
+            const double error = static_cast<double>(tested[i]) - reference[i];
+            result.maxAbsError = std::max(result.maxAbsError, std::abs(error));
+            signalEnergy += static_cast<double>(reference[i]) * reference[i];
+            errorEnergy += error * error;
+        }
+
+        if (errorEnergy > 0.0)
+            result.snrDb = signalEnergy > 0.0 ? 10.0 * std::log10(signalEnergy / errorEnergy)
+                                              : -std::numeric_limits<double>::infinity();
+        return result;
+    }
+
+    //==============================================================================
+    std::vector<TestSignal> createSyntheticSignals(double sampleRate)
+    {
+        const int length = static_cast<int>(sampleRate);
+        std::vector<TestSignal> signals;
+        juce::Random random(42);
+
+        const auto add = [&signals, length](const char* name, std::function<float(int)> generator)
+        {
+            TestSignal signal{ name, Signal(static_cast<size_t>(length)) };
+            for (int i = 0; i < length; ++i)
+                signal.samples[static_cast<size_t>(i)] = generator(i);
+            signals.push_back(std::move(signal));
+        };
+
+        const double twoPi = juce::MathConstants<double>::twoPi;
+
+        add("silence", [](int) { return 0.0f; });
+        add("sine-440", [=](int i) { return static_cast<float>(0.8 * std::sin(twoPi * 440.0 * i / sampleRate)); });
+        add("log-sweep", [=](int i)
+        {
+            // 20 Hz to 20 kHz over the signal length
+            const double t = i / sampleRate, duration = length / sampleRate, k = std::log(1000.0);
+            return static_cast<float>(0.8 * std::sin(twoPi * 20.0 * duration / k * (std::exp(k * t / duration) - 1.0)));
+        });
+        add("white-noise", [&random](int) { return random.nextFloat() * 2.0f - 1.0f; });
+        add("hot-noise", [&random](int) { return (random.nextFloat() * 2.0f - 1.0f) * 4.0f; });
+        add("impulses", [](int i) { return i % 1000 == 0 ? 1.0f : 0.0f; });
+        add("square-hot", [=](int i) { return std::fmod(i * 110.0 / sampleRate, 1.0) < 0.5 ? 3.0f : -3.0f; });
+        add("dc-step", [=](int i) { return i < length / 2 ? 0.0f : 0.5f; });
+
+        return signals;
+    }
+
+    void addCorpusSignals(const juce::File& directory, std::vector<TestSignal>& signals)
+    {
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        for (const auto& file : directory.findChildFiles(juce::File::findFiles, true, "*.wav;*.aif;*.aiff"))
+        {
+            std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+            if (reader == nullptr)
+                continue;
+
+            // Channel 0 of the first ten seconds is plenty to exercise the kernels
+            const int length = static_cast<int>(std::min<juce::int64>(reader->lengthInSamples,
+                                                                      static_cast<juce::int64>(reader->sampleRate * 10.0)));
+            juce::AudioBuffer<float> buffer(static_cast<int>(reader->numChannels), length);
+            reader->read(&buffer, 0, length, 0, true, true);
+
+            const float* data = buffer.getReadPointer(0);
+            signals.push_back({ file.getFileName(), Signal(data, data + length) });
+        }
+    }
+
+    //==============================================================================
+    std::vector<KernelCheck> createKernelChecks()
+    {
+        std::vector<KernelCheck> checks;
+
+        checks.push_back({ "resampler", { 1.0e-6, 120.0 },
+            [](const Signal& input, double sampleRate, Signal& reference, Signal& tested)
+            {
+                ReferenceDSP::Resampler referenceResampler;
+                DSPUtils::Resampler testedResampler;
+                referenceResampler.prepare(sampleRate);
+                testedResampler.prepare(sampleRate);
+
+                const int size = static_cast<int>(input.size());
+                for (double ratio : { 0.5, 1.0, 1.4983, 2.0 })
+                {
+                    for (double position = 0.0; position < size; position += ratio)
+                    {
+                        reference.push_back(referenceResampler.resample(input.data(), position, size));
+                        tested.push_back(testedResampler.resample(input.data(), position, size));
+                    }
+                }
+            }});
+
+        checks.push_back({ "grain-window", { 1.0e-6, 120.0 },
+            [](const Signal& input, double, Signal& reference, Signal& tested)
+            {
+                // Window the signal as one long grain at each overlap setting
+                const auto size = input.size();
+                for (float overlap : { 0.25f, 0.5f, 0.75f })
+                {
+                    for (size_t i = 0; i < size; ++i)
+                    {
+                        const float phase = static_cast<float>(i) / static_cast<float>(size);
+                        reference.push_back(input[i] * ReferenceDSP::GrainWindow::getGainAt(phase, overlap));
+                        tested.push_back(input[i] * DSPUtils::GrainWindow::getGainAt(phase, overlap));
+                    }
+                }
+            }});
+
+        checks.push_back({ "window-table", { 2.0e-5, 90.0 },
+            [](const Signal& input, double, Signal& reference, Signal& tested)
+            {
+                // The Classic table against the analytic window the engine used to evaluate
+                const auto size = input.size();
+                for (float overlap : { 0.25f, 0.5f, 0.75f })
+                {
+                    DSPUtils::WindowTable table;
+                    table.build(DSPUtils::GrainWindow::Shape::Classic, overlap);
+
+                    const auto increment = DSPUtils::WindowTable::getPhaseIncrement(static_cast<double>(size));
+                    juce::uint32 phase = 0;
+
+                    for (size_t i = 0; i < size; ++i, phase += increment)
+                    {
+                        const float exactPhase = static_cast<float>(phase) * (1.0f / 4294967296.0f);
+                        reference.push_back(input[i] * ReferenceDSP::GrainWindow::getGainAt(exactPhase, overlap));
+                        tested.push_back(input[i] * table.getGainAt(phase));
+                    }
+                }
+            }});
+
+        checks.push_back({ "grain-group", { 1.0e-5, 100.0 },
+            [](const Signal& input, double, Signal& reference, Signal& tested)
+            {
+                // Groups of grains through the --isa kernel against one grain
+                // at a time, straight from the table, for mono and stereo
+                // sources with and without looping. Starts crowd the end of
+                // the source, so grains wrap or run off it.
+                const int length = static_cast<int>(input.size());
+                const Signal reversed(input.rbegin(), input.rend());
+
+                DSPUtils::WindowTable table;
+                table.build(DSPUtils::GrainWindow::Shape::Classic, 0.5f);
+                juce::Random random(7);
+
+                for (bool stereo : { false, true })
+                {
+                    for (bool looping : { false, true })
+                    {
+                        DSPKernels::GrainSource source;
+                        source.channels[0] = input.data();
+                        source.channels[1] = stereo ? reversed.data() : input.data();
+                        source.stereo = stereo;
+                        source.length = length;
+                        source.looping = looping;
+                        source.window = table.data();
+
+                        for (int g = 0; g < 16; ++g)
+                        {
+                            // The last lane stays free
+                            DSPKernels::GrainGroup group{};
+                            int outputLength = 0;
+                            for (int lane = 0; lane < DSPKernels::GRAIN_LANES - 1; ++lane)
+                            {
+                                const int duration = 64 + random.nextInt(2000);
+                                group.start[lane] = std::max(0, length - 1 - random.nextInt(4000));
+                                group.offset[lane] = random.nextFloat();
+                                group.step[lane] = 0.25f + 1.75f * random.nextFloat();
+                                group.windowIncrement[lane] = DSPUtils::WindowTable::getPhaseIncrement(duration);
+                                group.gains[0][lane] = random.nextFloat();
+                                group.gains[1][lane] = random.nextFloat();
+                                group.delay[lane] = random.nextInt(static_cast<int>(2 * blockSize));
+                                group.remaining[lane] = duration;
+                                outputLength = std::max(outputLength, group.delay[lane] + duration);
+                            }
+
+                            outputLength = (outputLength + static_cast<int>(blockSize) - 1) / static_cast<int>(blockSize) * static_cast<int>(blockSize);
+                            Signal expected[2] = { Signal(static_cast<size_t>(outputLength)), Signal(static_cast<size_t>(outputLength)) };
+                            Signal rendered[2] = { Signal(static_cast<size_t>(outputLength)), Signal(static_cast<size_t>(outputLength)) };
+
+                            for (int lane = 0; lane < DSPKernels::GRAIN_LANES; ++lane)
+                            {
+                                float offset = group.offset[lane];
+                                juce::uint32 phase = group.windowPhase[lane];
+                                for (int k = 0; k < group.remaining[lane]; ++k)
+                                {
+                                    const int whole = static_cast<int>(std::floor(offset));
+                                    const float fraction = offset - static_cast<float>(whole);
+                                    int index = group.start[lane] + whole;
+                                    int next = index + 1;
+                                    if (looping)
+                                    {
+                                        index = index >= length ? index - length : index;
+                                        next = next >= length ? next - length : next;
+                                    }
+
+                                    if (index >= 0 && index < length && next >= 0 && next < length)
+                                    {
+                                        const auto t = static_cast<size_t>(group.delay[lane] + k);
+                                        const float gain = table.getGainAt(phase);
+                                        const float left = (source.channels[0][index] + fraction * (source.channels[0][next] - source.channels[0][index])) * gain;
+                                        const float right = stereo ? (source.channels[1][index] + fraction * (source.channels[1][next] - source.channels[1][index])) * gain
+                                                                   : left;
+                                        expected[0][t] += left * group.gains[0][lane];
+                                        expected[1][t] += right * group.gains[1][lane];
+                                    }
+
+                                    offset += group.step[lane];
+                                    phase += group.windowIncrement[lane];
+                                }
+                            }
+
+                            for (int start = 0; start < outputLength; start += static_cast<int>(blockSize))
+                            {
+                                float* out[2] = { rendered[0].data() + start, rendered[1].data() + start };
+                                testedKernels->renderGrainGroup(group, source, out, static_cast<int>(blockSize));
+                            }
+
+                            for (int channel = 0; channel < 2; ++channel)
+                            {
+                                reference.insert(reference.end(), expected[channel].begin(), expected[channel].end());
+                                tested.insert(tested.end(), rendered[channel].begin(), rendered[channel].end());
+                            }
+                        }
+                    }
+                }
+            }});
+
+        checks.push_back({ "butterworth", { 1.0e-5, 100.0 },
+            [](const Signal& input, double sampleRate, Signal& reference, Signal& tested)
+            {
+                for (float cutoff : { 1000.0f, 8000.0f, 13333.3f })
+                {
+                    ReferenceDSP::ButterworthFilter referenceFilter;
+                    DSPUtils::ButterworthFilter testedFilter;
+                    referenceFilter.prepare(sampleRate);
+                    testedFilter.prepare(sampleRate);
+                    referenceFilter.setCutoff(cutoff);
+                    testedFilter.setCutoff(cutoff);
+
+                    for (float x : input)
+                        reference.push_back(referenceFilter.process(x));
+
+                    Signal output = input;
+                    processInBlocks(output, testedFilter);
+                    tested.insert(tested.end(), output.begin(), output.end());
+                }
+            }});
+
+        checks.push_back({ "dc-blocker", { 1.0e-6, 120.0 },
+            [](const Signal& input, double, Signal& reference, Signal& tested)
+            {
+                ReferenceDSP::DCBlocker referenceBlocker;
+                DSPUtils::DCBlocker testedBlocker;
+
+                for (float x : input)
+                    reference.push_back(referenceBlocker.process(x));
+
+                tested = input;
+                processInBlocks(tested, testedBlocker);
+            }});
+
+        checks.push_back({ "soft-clipper", { 1.0e-5, 100.0 },
+            [](const Signal& input, double sampleRate, Signal& reference, Signal& tested)
+            {
+                // The reference clipper's 4x path only ever averaged identical
+                // copies, so its static curve is what the 1x block path must match
+                const auto referenceCurve = [](float x)
+                {
+                    x = std::tanh(x * 0.686f);
+                    return std::copysign(1.0f - std::exp(-std::abs(x)), x);
+                };
+
+                DSPUtils::SoftClipper testedClipper;
+                testedClipper.setKernels(*testedKernels);
+                testedClipper.prepare(sampleRate, blockSize);
+                testedClipper.setOversamplingFactor(1);
+
+                tested = input;
+                processInBlocks(tested, testedClipper);
+
+                for (float x : input)
+                    reference.push_back(referenceCurve(x));
+            }});
+
+        checks.push_back({ "soft-clipper-2x", { 2.0e-3, 50.0 },
+            [](const Signal& input, double sampleRate, Signal& reference, Signal& tested)
+            {
+                // Band-limited input only: the oversampled clipper should match
+                // the 1x curve, delayed by its latency, up to the removed harmonics
+                DSPUtils::SoftClipper testedClipper;
+                testedClipper.setKernels(*testedKernels);
+                testedClipper.prepare(sampleRate, blockSize);
+                testedClipper.setOversamplingFactor(2);
+                const auto latency = static_cast<size_t>(testedClipper.getLatencyInSamples());
+
+                Signal output = input;
+                processInBlocks(output, testedClipper);
+
+                for (size_t i = latency; i < input.size(); ++i)
+                {
+                    reference.push_back(DSPUtils::SoftClipper::processSample<DSPUtils::FastMath::Std>(input[i - latency]));
+                    tested.push_back(output[i]);
+                }
+            },
+            [](const juce::String& signalName) { return signalName == "sine-440" || signalName == "silence"; }});
+
+        checks.push_back({ "peak-limiter", { 1.0e-6, 120.0 },
+            [](const Signal& input, double sampleRate, Signal& reference, Signal& tested)
+            {
+                ReferenceDSP::PeakLimiter referenceLimiter;
+                DSPUtils::PeakLimiter testedLimiter;
+                referenceLimiter.prepare(sampleRate);
+                testedLimiter.prepare(sampleRate);
+
+                for (float x : input)
+                    reference.push_back(referenceLimiter.process(x));
+
+                tested = input;
+                processInBlocks(tested, testedLimiter);
+            }});
+
+        checks.push_back({ "lookahead-limiter", { 1.0e-6, 120.0 },
+            [](const Signal& input, double sampleRate, Signal& reference, Signal& tested)
+            {
+                // Below the threshold the limiter must be a pure delay on every linked channel
+                DSPUtils::LookaheadLimiter testedLimiter;
+                testedLimiter.setKernels(*testedKernels);
+                testedLimiter.prepare(sampleRate, static_cast<int>(blockSize), 2);
+                const auto latency = static_cast<size_t>(testedLimiter.getLatencyInSamples());
+
+                Signal left = input, right = input;
+                for (size_t start = 0; start < left.size(); start += blockSize)
+                {
+                    float* channels[] = { left.data() + start, right.data() + start };
+                    testedLimiter.process(channels, 2, static_cast<int>(std::min(blockSize, left.size() - start)));
+                }
+
+                for (size_t i = latency; i < input.size(); ++i)
+                {
+                    reference.push_back(input[i - latency]);
+                    reference.push_back(input[i - latency]);
+                    tested.push_back(left[i]);
+                    tested.push_back(right[i]);
+                }
+            },
+            [](const juce::String& signalName)
+            {
+                return signalName == "silence" || signalName == "sine-440"
+                    || signalName == "log-sweep" || signalName == "dc-step";
+            }});
+
+        // FastMath against libm, over the ranges the engine feeds them
+        checks.push_back({ "fast-tanh", { 1.0e-6, 120.0 },
+            [](const Signal& input, double, Signal& reference, Signal& tested)
+            {
+                for (float x : input)
+                {
+                    reference.push_back(std::tanh(x * 4.0f));
+                    tested.push_back(DSPUtils::FastMath::tanh(x * 4.0f));
+                }
+            }});
+
+        checks.push_back({ "fast-exp", { 1.0e-5, 100.0 },
+            [](const Signal& input, double, Signal& reference, Signal& tested)
+            {
+                for (float x : input)
+                {
+                    reference.push_back(std::exp(-std::abs(x) * 4.0f));
+                    tested.push_back(DSPUtils::FastMath::exp(-std::abs(x) * 4.0f));
+                }
+            }});
+
+        checks.push_back({ "fast-sincos", { 1.0e-6, 120.0 },
+            [](const Signal& input, double, Signal& reference, Signal& tested)
+            {
+                // Phase arguments up to a few hundred radians, as in grain phase alignment
+                for (float x : input)
+                {
+                    const float phase = x * 300.0f;
+                    reference.push_back(std::cos(phase));
+                    tested.push_back(DSPUtils::FastMath::cos(phase));
+                    reference.push_back(std::sin(phase));
+                    tested.push_back(DSPUtils::FastMath::sin(phase));
+                }
+            }});
+
+        return checks;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    const double sampleRate = args.containsOption("--rate") ? args.getValueForOption("--rate").getDoubleValue()
+                                                            : 48000.0;
+    const bool verbose = args.containsOption("--verbose");
+
+    const auto isa = args.containsOption("--isa") ? DSPKernels::parseISA(args.getValueForOption("--isa"))
+                                                  : DSPKernels::getPreferredISA();
+    if (!DSPKernels::isSupported(isa))
+    {
+        std::fprintf(stderr, "--isa must be one this build and CPU support (generic, avx2, avx512)\n");
+        return 1;
+    }
+
+    testedKernels = &DSPKernels::getTable(isa);
+    std::printf("kernels: %s\n", DSPKernels::getName(isa));
+
+    auto signals = createSyntheticSignals(sampleRate);
+    if (args.containsOption("--corpus"))
+        addCorpusSignals(args.getExistingFileForOption("--corpus"), signals);
+
+    const auto checks = createKernelChecks();
+    bool allPassed = true;
+
+    std::printf("%-16s %14s %10s %14s %10s  %s\n",
+                "kernel", "max|err|", "SNR(dB)", "tol |err|", "tol SNR", "result");
+
+    for (const auto& check : checks)
+    {
+        Comparison worst;
+        juce::StringArray failures;
+
+        for (const auto& signal : signals)
+        {
+            if (check.appliesTo && !check.appliesTo(signal.name))
+                continue;
+
+            Signal reference, tested;
+            check.render(signal.samples, sampleRate, reference, tested);
+
+            const auto result = compare(reference, tested);
+            const bool passed = result.maxAbsError <= check.tolerance.maxAbsError
+                             && result.snrDb >= check.tolerance.minSnrDb;
+
+            if (!passed)
+                failures.add(signal.name);
+
+            if (verbose)
+                std::printf("  %-14s %-20s %14.3e %10.1f\n", check.name, signal.name.toRawUTF8(),
+                            result.maxAbsError, result.snrDb);
+
+            worst.maxAbsError = std::max(worst.maxAbsError, result.maxAbsError);
+            worst.snrDb = std::min(worst.snrDb, result.snrDb);
+        }
+
+        allPassed = allPassed && failures.size() == 0;
+
+        std::printf("%-16s %14.3e %10.1f %14.3e %10.1f  %s\n",
+                    check.name, worst.maxAbsError, worst.snrDb,
+                    check.tolerance.maxAbsError, check.tolerance.minSnrDb,
+                    failures.size() == 0 ? "ok"
+                                         : ("FAIL (" + failures.joinIntoString(", ") + ")").toRawUTF8());
+    }
+
+    return allPassed ? 0 : 1;
+}
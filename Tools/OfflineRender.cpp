@@ -0,0 +1,340 @@
+#include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include "PluginProcessor.h"
+#include "SessionRecorder.h"
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+// Bounces sample + MIDI + preset to WAV through a headless processor, as fast
+// as the CPU allows. Independent jobs run on a pool sized to the machine, and
+// each job can spread its voices over further threads.
+//
+// Usage: speculator-render <sample> <midi> <out.wav> [--preset file.xml]
+//        speculator-render --batch <jobs.txt>
+//            [--rate Hz] [--block N] [--tail seconds] [--bits 16|24|32]
+//            [--jobs N] [--voice-threads N]
+//
+// A batch file holds one job per line, "<sample> <midi> <out.wav> [preset]",
+// with paths quoted when they contain spaces and # starting a comment.
+// A preset is an XML element whose attributes are parameter names, e.g.
+// <SpeculatorPreset PlaybackSpeed="0.5" HoldMode="1" Spread="0.3"/>
+
+namespace
+{
+    constexpr int INDEX_WAIT_MS = 60000;
+
+    struct RenderJob
+    {
+        juce::File sample, midi, output, preset;
+    };
+
+    struct RenderSettings
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 1024;
+        double tailSeconds = 2.0;
+        int bitDepth = 24;
+        int voiceThreads = 1;
+    };
+
+    struct RenderResult
+    {
+        bool ok = false;
+        juce::String error;
+        double renderedSeconds = 0.0;
+        double processSeconds = 0.0;
+    };
+
+    bool loadMidi(const juce::File& file, juce::MidiMessageSequence& sequence, juce::String& error)
+    {
+        juce::FileInputStream stream(file);
+        juce::MidiFile midiFile;
+
+        if (!stream.openedOk() || !midiFile.readFrom(stream))
+        {
+            error = "could not read MIDI file " + file.getFullPathName();
+            return false;
+        }
+
+        // All tracks merged into one time-ordered stream
+        midiFile.convertTimestampTicksToSeconds();
+        for (int track = 0; track < midiFile.getNumTracks(); ++track)
+            sequence.addSequence(*midiFile.getTrack(track), 0.0);
+
+        return true;
+    }
+
+    bool applyPreset(SondyQ2AudioProcessor& processor, const juce::File& file, juce::String& error)
+    {
+        const auto xml = juce::parseXML(file);
+        if (xml == nullptr)
+        {
+            error = "could not parse preset " + file.getFullPathName();
+            return false;
+        }
+
+        for (int attribute = 0; attribute < xml->getNumAttributes(); ++attribute)
+        {
+            const auto name = xml->getAttributeName(attribute);
+            int parameter = 0;
+
+            for (; parameter < static_cast<int>(SessionLog::ParameterId::NumParameters); ++parameter)
+            {
+                if (name == SessionLog::getParameterName(static_cast<SessionLog::ParameterId>(parameter)))
+                    break;
+            }
+
+            if (parameter == static_cast<int>(SessionLog::ParameterId::NumParameters))
+            {
+                error = "unknown parameter " + name + " in " + file.getFullPathName();
+                return false;
+            }
+
+            processor.applyParameter(static_cast<SessionLog::ParameterId>(parameter),
+                                     xml->getAttributeValue(attribute).getFloatValue());
+        }
+
+        return true;
+    }
+
+    RenderResult render(const RenderJob& job, const RenderSettings& settings)
+    {
+        RenderResult result;
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        // A bounce, so the processor picks its offline engine configuration
+        SondyQ2AudioProcessor processor;
+        processor.setNonRealtime(true);
+        processor.loadSample(job.sample);
+        if (!processor.getSamplePlayer()->isFileLoaded())
+        {
+            result.error = "could not load sample " + job.sample.getFullPathName();
+            return result;
+        }
+
+        juce::MidiMessageSequence sequence;
+        if (!loadMidi(job.midi, sequence, result.error))
+            return result;
+
+        if (job.preset != juce::File{} && !applyPreset(processor, job.preset, result.error))
+            return result;
+
+        // Voice threads are this job's own, so a job never waits on another's work
+        std::unique_ptr<juce::ThreadPool> voicePool;
+        if (settings.voiceThreads > 1)
+        {
+            voicePool = std::make_unique<juce::ThreadPool>(settings.voiceThreads - 1);
+            processor.getSamplePlayer()->setVoiceThreadPool(voicePool.get());
+        }
+
+        processor.setRateAndBufferSizeDetails(settings.sampleRate, settings.blockSize);
+        processor.prepareToPlay(settings.sampleRate, settings.blockSize);
+
+        // Built before the first block rather than waited on from the render thread
+        if (!processor.getSamplePlayer()->waitForIndexes(INDEX_WAIT_MS))
+        {
+            result.error = "timed out analysing " + job.sample.getFullPathName();
+            return result;
+        }
+
+        job.output.getParentDirectory().createDirectory();
+        job.output.deleteFile();
+        auto stream = std::make_unique<juce::FileOutputStream>(job.output);
+        if (!stream->openedOk())
+        {
+            result.error = "could not write " + job.output.getFullPathName();
+            return result;
+        }
+
+        juce::WavAudioFormat wavFormat;
+        std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(stream.get(), settings.sampleRate, 2,
+                                                                                  settings.bitDepth, {}, 0));
+        if (writer == nullptr)
+        {
+            result.error = "unsupported WAV format for " + job.output.getFullPathName();
+            return result;
+        }
+        stream.release();  // Owned by the writer now
+
+        // The first latency samples are dropped, so the file lines up with the MIDI
+        const juce::int64 latency = processor.getLatencySamples();
+        const auto totalSamples = static_cast<juce::int64>(std::ceil((sequence.getEndTime() + settings.tailSeconds) * settings.sampleRate));
+
+        juce::AudioBuffer<float> buffer(2, settings.blockSize);
+        juce::MidiBuffer midi;
+        int eventIndex = 0;
+
+        for (juce::int64 position = 0; position < totalSamples + latency; position += settings.blockSize)
+        {
+            const juce::int64 blockEnd = position + settings.blockSize;
+            midi.clear();
+
+            for (; eventIndex < sequence.getNumEvents(); ++eventIndex)
+            {
+                const auto& message = sequence.getEventPointer(eventIndex)->message;
+                const auto samplePosition = static_cast<juce::int64>(message.getTimeStamp() * settings.sampleRate + 0.5);
+                if (samplePosition >= blockEnd)
+                    break;
+
+                if (!message.isMetaEvent())
+                    midi.addEvent(message, static_cast<int>(samplePosition - position));
+            }
+
+            buffer.clear();
+            processor.processBlock(buffer, midi);
+
+            const auto skip = static_cast<int>(juce::jlimit<juce::int64>(0, settings.blockSize, latency - position));
+            const auto written = std::max<juce::int64>(0, position + skip - latency);
+            const auto numToWrite = static_cast<int>(std::min<juce::int64>(settings.blockSize - skip, totalSamples - written));
+
+            if (numToWrite > 0 && !writer->writeFromAudioSampleBuffer(buffer, skip, numToWrite))
+            {
+                result.error = "write failed for " + job.output.getFullPathName();
+                return result;
+            }
+        }
+
+        const auto end = juce::Time::getHighResolutionTicks();
+        result.ok = true;
+        result.renderedSeconds = totalSamples / settings.sampleRate;
+        result.processSeconds = juce::Time::highResolutionTicksToSeconds(end - start);
+        return result;
+    }
+
+    bool readBatch(const juce::File& batchFile, std::vector<RenderJob>& jobs)
+    {
+        juce::StringArray lines;
+        batchFile.readLines(lines);
+
+        for (int lineIndex = 0; lineIndex < lines.size(); ++lineIndex)
+        {
+            const auto line = lines[lineIndex].upToFirstOccurrenceOf("#", false, false).trim();
+            if (line.isEmpty())
+                continue;
+
+            juce::StringArray fields;
+            fields.addTokens(line, " \t", "\"");
+            fields.removeEmptyStrings();
+
+            if (fields.size() < 3 || fields.size() > 4)
+            {
+                std::fprintf(stderr, "%s:%d: expected <sample> <midi> <out.wav> [preset]\n",
+                             batchFile.getFullPathName().toRawUTF8(), lineIndex + 1);
+                return false;
+            }
+
+            // Relative paths are relative to the batch file
+            const auto resolve = [&batchFile](const juce::String& path)
+            {
+                return batchFile.getParentDirectory().getChildFile(path.unquoted());
+            };
+
+            jobs.push_back({ resolve(fields[0]), resolve(fields[1]), resolve(fields[2]),
+                             fields.size() > 3 ? resolve(fields[3]) : juce::File{} });
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    const auto optionOr = [&args](const juce::String& option, const juce::String& fallback)
+    {
+        return args.containsOption(option) ? args.getValueForOption(option) : fallback;
+    };
+
+    std::vector<RenderJob> jobs;
+
+    if (args.containsOption("--batch"))
+    {
+        if (!readBatch(args.getFileForOption("--batch"), jobs))
+            return 1;
+    }
+    else if (args.size() >= 3 && !args.arguments[0].isOption())
+    {
+        jobs.push_back({ args.arguments[0].resolveAsFile(), args.arguments[1].resolveAsFile(),
+                         args.arguments[2].resolveAsFile(),
+                         args.containsOption("--preset") ? args.getFileForOption("--preset") : juce::File{} });
+    }
+    else
+    {
+        std::fprintf(stderr, "Usage: speculator-render <sample> <midi> <out.wav> [--preset file.xml]\n"
+                             "       speculator-render --batch <jobs.txt>\n"
+                             "           [--rate Hz] [--block N] [--tail seconds] [--bits 16|24|32]\n"
+                             "           [--jobs N] [--voice-threads N]\n");
+        return 1;
+    }
+
+    if (jobs.empty())
+    {
+        std::fprintf(stderr, "Nothing to render\n");
+        return 1;
+    }
+
+    RenderSettings settings;
+    settings.sampleRate = optionOr("--rate", "48000").getDoubleValue();
+    settings.blockSize = juce::jlimit(32, 8192, optionOr("--block", "1024").getIntValue());
+    settings.tailSeconds = juce::jmax(0.0, optionOr("--tail", "2").getDoubleValue());
+    settings.bitDepth = optionOr("--bits", "24").getIntValue();
+
+    // By default jobs fill the cores first, and whatever is left over goes to voices
+    const int numCpus = juce::SystemStats::getNumCpus();
+    const int numJobThreads = juce::jlimit(1, static_cast<int>(jobs.size()),
+                                           optionOr("--jobs", juce::String(numCpus)).getIntValue());
+    settings.voiceThreads = juce::jmax(1, optionOr("--voice-threads", juce::String(numCpus / numJobThreads)).getIntValue());
+
+    std::printf("%d job(s) on %d thread(s), %d voice thread(s) each\n",
+                static_cast<int>(jobs.size()), numJobThreads, settings.voiceThreads);
+
+    std::vector<RenderResult> results(jobs.size());
+    std::atomic<int> jobsRemaining{ static_cast<int>(jobs.size()) };
+    juce::WaitableEvent allJobsFinished;
+    const auto start = juce::Time::getHighResolutionTicks();
+
+    {
+        juce::ThreadPool jobPool(numJobThreads);
+
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            jobPool.addJob([&, i]
+            {
+                results[i] = render(jobs[i], settings);
+                if (--jobsRemaining == 0)
+                    allJobsFinished.signal();
+            });
+        }
+
+        allJobsFinished.wait();
+    }
+
+    const double wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+    double renderedSeconds = 0.0;
+    bool failed = false;
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        const auto& result = results[i];
+        if (!result.ok)
+        {
+            std::fprintf(stderr, "FAILED %s: %s\n", jobs[i].output.getFullPathName().toRawUTF8(), result.error.toRawUTF8());
+            failed = true;
+            continue;
+        }
+
+        renderedSeconds += result.renderedSeconds;
+        std::printf("%s: %.2f s audio in %.3f s (%.1fx realtime)\n",
+                    jobs[i].output.getFullPathName().toRawUTF8(), result.renderedSeconds, result.processSeconds,
+                    result.processSeconds > 0.0 ? result.renderedSeconds / result.processSeconds : 0.0);
+    }
+
+    std::printf("total: %.2f s audio in %.3f s wall clock (%.1fx realtime)\n",
+                renderedSeconds, wallSeconds, wallSeconds > 0.0 ? renderedSeconds / wallSeconds : 0.0);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+#include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
+#include "PluginProcessor.h"
+#include "SessionRecorder.h"
+#include <cstdio>
+
+// Replays a session log captured by SondyQ2AudioProcessor::startSessionRecording
+// through a fresh, headless processor as fast as possible, and reports how
+// long each block took against its real-time deadline.
+//
+// Usage: speculator-replay <session.spql> [--sample file] [--repeat N] [--governor]
+//
+// The CPU governor is off unless --governor is given, so the timings are for
+// full quality. Before each block, outside its timing, the replay waits for
+// the sample's indexes to finish building, so every replay renders the same
+// way however fast the index threads run.
+
+namespace
+{
+    constexpr int INDEX_WAIT_MS = 60000;
+
+    struct ReplayStats
+    {
+        int numBlocks = 0;
+        double renderedSeconds = 0.0;
+        double processSeconds = 0.0;
+        double worstBlockLoad = 0.0;
+        int worstBlockIndex = -1;
+    };
+
+    bool replay(const juce::File& logFile, const juce::File& sampleOverride, bool useGovernor, ReplayStats& stats)
+    {
+        SessionReader reader;
+        if (!reader.open(logFile))
+        {
+            std::fprintf(stderr, "Could not read session log %s\n", logFile.getFullPathName().toRawUTF8());
+            return false;
+        }
+
+        SondyQ2AudioProcessor processor;
+        processor.setAdaptiveQuality(useGovernor);
+
+        // The header holds the sample loaded when recording started, empty if
+        // none was; Sample records follow each load after that. --sample
+        // stands in for every one of them.
+        const auto loadSample = [&](const juce::String& recordedPath)
+        {
+            if (recordedPath.isEmpty() && sampleOverride == juce::File{})
+                return true;
+
+            const juce::File sampleFile = sampleOverride != juce::File{} ? sampleOverride : juce::File(recordedPath);
+            if (!sampleFile.existsAsFile())
+            {
+                std::fprintf(stderr, "Sample not found: %s (use --sample)\n", sampleFile.getFullPathName().toRawUTF8());
+                return false;
+            }
+
+            processor.loadSample(sampleFile);
+            return true;
+        };
+
+        if (!loadSample(reader.getSamplePath()))
+            return false;
+
+        juce::AudioBuffer<float> buffer;
+        juce::MidiBuffer midi;
+        double sampleRate = 44100.0;
+        SessionLog::Record record;
+
+        while (reader.readNext(record))
+        {
+            switch (record.type)
+            {
+                case SessionLog::RecordType::Prepare:
+                    sampleRate = record.sampleRate;
+                    processor.setRateAndBufferSizeDetails(sampleRate, record.numSamples);
+                    processor.prepareToPlay(sampleRate, record.numSamples);
+                    buffer.setSize(2, record.numSamples);
+                    break;
+
+                case SessionLog::RecordType::Parameter:
+                    processor.applyParameter(record.parameter, record.value);
+                    break;
+
+                case SessionLog::RecordType::Sample:
+                    if (!loadSample(record.samplePath))
+                        return false;
+                    break;
+
+                case SessionLog::RecordType::Midi:
+                    midi.addEvent(record.midiData, record.midiSize, record.samplePosition);
+                    break;
+
+                case SessionLog::RecordType::Block:
+                {
+                    buffer.setSize(2, record.numSamples, false, false, true);
+                    buffer.clear();
+
+                    if (!processor.getSamplePlayer()->waitForIndexes(INDEX_WAIT_MS))
+                        std::fprintf(stderr, "Block %d rendered before the sample's indexes were built\n", stats.numBlocks);
+
+                    const auto start = juce::Time::getHighResolutionTicks();
+                    processor.processBlock(buffer, midi);
+                    const auto end = juce::Time::getHighResolutionTicks();
+
+                    const double seconds = juce::Time::highResolutionTicksToSeconds(end - start);
+                    const double load = seconds / (record.numSamples / sampleRate);
+                    if (load > stats.worstBlockLoad)
+                    {
+                        stats.worstBlockLoad = load;
+                        stats.worstBlockIndex = stats.numBlocks;
+                    }
+
+                    stats.processSeconds += seconds;
+                    stats.renderedSeconds += record.numSamples / sampleRate;
+                    ++stats.numBlocks;
+                    midi.clear();
+                    break;
+                }
+            }
+        }
+
+        if (reader.hasFailed())
+        {
+            std::fprintf(stderr, "Session log %s is truncated or corrupt after block %d\n",
+                         logFile.getFullPathName().toRawUTF8(), stats.numBlocks);
+            return false;
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    if (args.size() < 1 || args.arguments[0].isOption())
+    {
+        std::fprintf(stderr, "Usage: speculator-replay <session.spql> [--sample file] [--repeat N] [--governor]\n");
+        return 1;
+    }
+
+    const juce::File logFile = args.arguments[0].resolveAsFile();
+    const juce::File sampleOverride = args.containsOption("--sample") ? args.getFileForOption("--sample")
+                                                                      : juce::File{};
+    const int repeats = args.containsOption("--repeat") ? juce::jmax(1, args.getValueForOption("--repeat").getIntValue())
+                                                        : 1;
+
+    for (int pass = 0; pass < repeats; ++pass)
+    {
+        ReplayStats stats;
+        if (!replay(logFile, sampleOverride, args.containsOption("--governor"), stats))
+            return 1;
+
+        std::printf("pass %d: %d blocks, %.2f s audio in %.3f s (%.1fx realtime), worst block #%d at %.1f%% of deadline\n",
+                    pass + 1, stats.numBlocks, stats.renderedSeconds, stats.processSeconds,
+                    stats.processSeconds > 0.0 ? stats.renderedSeconds / stats.processSeconds : 0.0,
+                    stats.worstBlockIndex, stats.worstBlockLoad * 100.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "PluginProcessor.h"
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+// Worst-case latency harness for SamplePlayer.
+//
+// Hammers the MIDI and render paths with randomized event storms at small
+// block sizes, straight into the player or, for timed MIDI, through the
+// processor and reports the maximum and 99.9th percentile block time of each
+// scenario as a fraction of the real-time deadline. Exits non-zero when any
+// scenario goes over budget, so it can gate changes to the voice code.
+//
+// Usage: speculator-stress [--blocks N] [--rate Hz] [--seed N]
+//                          [--budget-p999 fraction] [--budget-max fraction]
+//                          [--isa generic|avx2|avx512]
+
+namespace
+{
+    struct Scenario
+    {
+        const char* name;
+        std::function<void(SamplePlayer&, juce::Random&, int blockIndex)> feed;
+
+        // Timed MIDI for the block. When set, the block goes through
+        // SondyQ2AudioProcessor::processBlock, which splits it at the events
+        std::function<void(juce::MidiBuffer&, juce::Random&, int blockSize)> timedMidi = {};
+    };
+
+    struct BlockStats
+    {
+        double maxSeconds = 0.0;
+        double p999Seconds = 0.0;
+        double meanSeconds = 0.0;
+    };
+
+    void noteOn(SamplePlayer& player, int note, float velocity)
+    {
+        player.handleMidiMessage(juce::MidiMessage::noteOn(1, note, velocity));
+    }
+
+    void noteOff(SamplePlayer& player, int note)
+    {
+        player.handleMidiMessage(juce::MidiMessage::noteOff(1, note));
+    }
+
+    std::vector<Scenario> createScenarios()
+    {
+        std::vector<Scenario> scenarios;
+
+        // Random chords and releases across the keyboard
+        scenarios.push_back({ "note-bursts", [](SamplePlayer& player, juce::Random& random, int)
+        {
+            player.setPlaybackMode(SamplePlayer::PlaybackMode::Polyphonic);
+            const int numEvents = random.nextInt(8);
+            for (int i = 0; i < numEvents; ++i)
+            {
+                const int note = 36 + random.nextInt(48);
+                if (random.nextBool())
+                    noteOn(player, note, 0.2f + 0.8f * random.nextFloat());
+                else
+                    noteOff(player, note);
+            }
+        }});
+
+        // More note-ons per block than there are voices, never released
+        scenarios.push_back({ "voice-steal-storm", [](SamplePlayer& player, juce::Random& random, int)
+        {
+            player.setPlaybackMode(SamplePlayer::PlaybackMode::OneShot);
+            const int numEvents = 16 + random.nextInt(16);
+            for (int i = 0; i < numEvents; ++i)
+                noteOn(player, 24 + random.nextInt(72), random.nextFloat());
+        }});
+
+        // Playback mode, hold and loop flipping under a steady note stream
+        scenarios.push_back({ "mode-switch", [](SamplePlayer& player, juce::Random& random, int blockIndex)
+        {
+            static const SamplePlayer::PlaybackMode modes[] = {
+                SamplePlayer::PlaybackMode::Polyphonic,
+                SamplePlayer::PlaybackMode::Monophonic,
+                SamplePlayer::PlaybackMode::OneShot
+            };
+
+            player.setPlaybackMode(modes[blockIndex % 3]);
+            player.setHoldMode(random.nextBool());
+            player.setLooping(random.nextBool());
+
+            for (int i = 0; i < 4; ++i)
+                noteOn(player, 48 + random.nextInt(24), random.nextFloat());
+            noteOff(player, 48 + random.nextInt(24));
+        }});
+
+        // Hold mode with the position dragged around on every block
+        scenarios.push_back({ "hold-scrub", [](SamplePlayer& player, juce::Random& random, int blockIndex)
+        {
+            player.setPlaybackMode(SamplePlayer::PlaybackMode::Polyphonic);
+            player.setHoldMode(true);
+            player.setHoldPosition(random.nextDouble());
+            player.setGrainDuration(0.05f + 0.45f * random.nextFloat());
+
+            if (blockIndex % 32 == 0)
+                for (int i = 0; i < 8; ++i)
+                    noteOn(player, 48 + i * 3, 0.8f);
+        }});
+
+        // Cloud mode at full density on every voice, with all the jitter, so
+        // the grain pool and the block budget are the limits
+        scenarios.push_back({ "dense-cloud", [](SamplePlayer& player, juce::Random& random, int blockIndex)
+        {
+            player.setSynthesisMode(SamplePlayer::SynthesisMode::Cloud);
+            player.setPlaybackMode(SamplePlayer::PlaybackMode::OneShot);
+            player.setLooping(true);
+            player.setCloudDensity(SamplePlayer::MAX_CLOUD_DENSITY);
+            player.setPositionJitter(0.5f);
+            player.setPitchJitter(12.0f);
+            player.setDurationJitter(1.0f);
+            player.setSpread(1.0f);
+            player.setGrainDuration(0.05f + 0.45f * random.nextFloat());
+
+            if (blockIndex % 16 == 0)
+                for (int i = 0; i < SamplePlayer::MAX_VOICES; ++i)
+                    noteOn(player, 36 + random.nextInt(48), 0.8f);
+        }});
+
+        // A controller and pitch bend on every sample under a held chord, with
+        // a few notes landing close together, through the processor's span
+        // splitting
+        scenarios.push_back({ "controller-storm", [](SamplePlayer& player, juce::Random&, int blockIndex)
+        {
+            player.setPlaybackMode(SamplePlayer::PlaybackMode::Polyphonic);
+            if (blockIndex % 64 == 0)
+                for (int i = 0; i < 4; ++i)
+                    noteOn(player, 48 + i * 4, 0.8f);
+        },
+        [](juce::MidiBuffer& midi, juce::Random& random, int blockSize)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                midi.addEvent(juce::MidiMessage::controllerEvent(1, SamplePlayer::FIRST_DESCRIPTOR_CC + i % 5, random.nextInt(128)), i);
+                midi.addEvent(juce::MidiMessage::pitchWheel(1, random.nextInt(16384)), i);
+            }
+
+            const int numNotes = random.nextInt(6);
+            for (int i = 0; i < numNotes; ++i)
+            {
+                const int note = 60 + random.nextInt(24);
+                const int position = random.nextInt(blockSize);
+                midi.addEvent(random.nextBool() ? juce::MidiMessage::noteOn(1, note, 0.8f) : juce::MidiMessage::noteOff(1, note), position);
+            }
+        }});
+
+        return scenarios;
+    }
+
+    juce::AudioBuffer<float> createTestSample(double sampleRate)
+    {
+        // Two seconds of a detuned saw pair with a noise burst, enough content
+        // to keep the resampler and clipper busy
+        juce::AudioBuffer<float> sample(2, static_cast<int>(sampleRate * 2.0));
+        juce::Random random(1234);
+
+        for (int channel = 0; channel < sample.getNumChannels(); ++channel)
+        {
+            float* data = sample.getWritePointer(channel);
+            double phaseA = 0.0, phaseB = 0.0;
+
+            for (int i = 0; i < sample.getNumSamples(); ++i)
+            {
+                phaseA = std::fmod(phaseA + 110.0 / sampleRate, 1.0);
+                phaseB = std::fmod(phaseB + (110.7 + channel) / sampleRate, 1.0);
+                const float noise = i < sampleRate * 0.05 ? random.nextFloat() * 2.0f - 1.0f : 0.0f;
+                data[i] = static_cast<float>(phaseA + phaseB - 1.0) * 0.5f + noise;
+            }
+        }
+
+        return sample;
+    }
+
+    BlockStats runScenario(const Scenario& scenario, const juce::AudioBuffer<float>& sample,
+                           double sampleRate, int blockSize, int numBlocks, juce::int64 seed, DSPKernels::ISA isa)
+    {
+        SondyQ2AudioProcessor processor;
+        processor.setAdaptiveQuality(false);
+        auto& player = *processor.getSamplePlayer();
+        player.loadBuffer(sample, sampleRate);
+        processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+        player.setKernelISA(isa);
+
+        juce::AudioBuffer<float> buffer(2, blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random(seed);
+        std::vector<double> blockTimes(static_cast<size_t>(numBlocks));
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            scenario.feed(player, random, block);
+            if (scenario.timedMidi)
+            {
+                midi.clear();
+                scenario.timedMidi(midi, random, blockSize);
+                processor.processBlock(buffer, midi);
+            }
+            else
+            {
+                player.processBlock(buffer, 0, blockSize);
+            }
+
+            const auto end = juce::Time::getHighResolutionTicks();
+            blockTimes[static_cast<size_t>(block)] = juce::Time::highResolutionTicksToSeconds(end - start);
+        }
+
+        BlockStats stats;
+        for (auto time : blockTimes)
+            stats.meanSeconds += time;
+        stats.meanSeconds /= numBlocks;
+
+        std::sort(blockTimes.begin(), blockTimes.end());
+        stats.maxSeconds = blockTimes.back();
+        stats.p999Seconds = blockTimes[static_cast<size_t>((numBlocks - 1) * 0.999)];
+        return stats;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    const auto optionOr = [&args](const juce::String& option, const juce::String& fallback)
+    {
+        return args.containsOption(option) ? args.getValueForOption(option) : fallback;
+    };
+
+    const int numBlocks = juce::jmax(1000, optionOr("--blocks", "20000").getIntValue());
+    const double sampleRate = optionOr("--rate", "48000").getDoubleValue();
+    const juce::int64 seed = optionOr("--seed", "1").getIntValue();
+    const double p999Budget = optionOr("--budget-p999", "0.25").getDoubleValue();
+    const double maxBudget = optionOr("--budget-max", "1.0").getDoubleValue();
+
+    const auto isa = args.containsOption("--isa") ? DSPKernels::parseISA(args.getValueForOption("--isa"))
+                                                  : DSPKernels::getPreferredISA();
+    if (!DSPKernels::isSupported(isa))
+    {
+        std::fprintf(stderr, "--isa must be one this build and CPU support (generic, avx2, avx512)\n");
+        return 1;
+    }
+
+    std::printf("kernels: %s\n", DSPKernels::getName(isa));
+
+    const int blockSizes[] = { 16, 32, 64, 128 };
+    const auto sample = createTestSample(sampleRate);
+    const auto scenarios = createScenarios();
+    bool overBudget = false;
+
+    std::printf("%-20s %6s %10s %10s %10s %8s %8s\n",
+                "scenario", "block", "mean(us)", "p99.9(us)", "max(us)", "p99.9%", "max%");
+
+    for (const auto& scenario : scenarios)
+    {
+        for (int blockSize : blockSizes)
+        {
+            const double deadline = blockSize / sampleRate;
+            const auto stats = runScenario(scenario, sample, sampleRate, blockSize, numBlocks, seed, isa);
+
+            const double p999Load = stats.p999Seconds / deadline;
+            const double maxLoad = stats.maxSeconds / deadline;
+            const bool failed = p999Load > p999Budget || maxLoad > maxBudget;
+            overBudget = overBudget || failed;
+
+            std::printf("%-20s %6d %10.2f %10.2f %10.2f %7.1f%% %7.1f%%%s\n",
+                        scenario.name, blockSize,
+                        stats.meanSeconds * 1.0e6, stats.p999Seconds * 1.0e6, stats.maxSeconds * 1.0e6,
+                        p999Load * 100.0, maxLoad * 100.0,
+                        failed ? "  OVER BUDGET" : "");
+        }
+    }
+
+    return overBudget ? 1 : 0;
+}